@@ -11,71 +11,13 @@
 #include "defs.h"
 #include "data.h"
 #include "protos.h"
-
-// ----------------------------------------------------------------------------
-
-typedef unsigned long long uint64;
-
-/*
-A 32 bit random number generator. An implementation in C of the algorithm
-given by Knuth, the art of computer programming, vol. 2, pp. 26-27. We use e=32, so
-we have to evaluate y(n) = y(n - 24) + y(n - 55) mod 2^32, which is
-implicitly
-done by unsigned arithmetic.
-*/
-/*
- random numbers from Mathematica 2.0.
- SeedRandom = 1;
- Table[Random[Integer, {0, 2^32 - 1}]
- */
-unsigned long x[55] = {
-	1410651636UL, 3012776752UL, 3497475623UL, 2892145026UL, 1571949714UL,
-	3253082284UL, 3489895018UL, 387949491UL, 2597396737UL, 1981903553UL,
-	3160251843UL, 129444464UL, 1851443344UL, 4156445905UL, 224604922UL,
-	1455067070UL, 3953493484UL, 1460937157UL, 2528362617UL, 317430674UL,
-	3229354360UL, 117491133UL, 832845075UL, 1961600170UL, 1321557429UL,
-	747750121UL, 545747446UL, 810476036UL, 503334515UL, 4088144633UL,
-	2824216555UL, 3738252341UL, 3493754131UL, 3672533954UL, 29494241UL,
-	1180928407UL, 4213624418UL, 33062851UL, 3221315737UL, 1145213552UL,
-	2957984897UL, 4078668503UL, 2262661702UL, 65478801UL, 2527208841UL,
-	1960622036UL, 315685891UL, 1196037864UL, 804614524UL, 1421733266UL,
-	2017105031UL, 3882325900UL, 810735053UL, 384606609UL, 2393861397UL };
-
-static unsigned long y[55];
-static int j, k;
-static int initAl = 1;
-unsigned long ul;
-
-static unsigned int Aleatoire(void)
-{
-	unsigned long ul;
-	if (initAl)
-	{
-		int i;
-		initAl = 0;
-		for (i = 0; i < 55; i++) y[i] = x[i];
-		j = 24 - 1;
-		k = 55 - 1;
-	}
-	ul = (y[k] += y[j]);
-	if (--j < 0) j = 55 - 1;
-	if (--k < 0) k = 55 - 1;
-	return((unsigned int)ul);
-}
-
-uint64 Aleatoire64()
-{
-	uint64 n1, n2, n3, n4;
-
-	n1 = (uint64)(Aleatoire()) & 0xFFFF;
-	n2 = (uint64)(Aleatoire()) & 0xFFFF;
-	n3 = (uint64)(Aleatoire()) & 0xFFFF;
-	n4 = (uint64)(Aleatoire()) & 0xFFFF;
-
-	return n1 | (n2 << 16) | (n3 << 32) | (n4 << 48);
-}
-
-// ----------------------------------------------------------------------------
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define BOARD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOARD_SSE2
+#endif
 
 
 /* init_board() sets the board to the initial game state. */
@@ -84,10 +26,8 @@ void init_board()
 {
 	int i;
 
-	for (i = 0; i < 64; ++i) {
-		color[i] = init_color[i];
-		piece[i] = init_piece[i];
-	}
+	for (i = 0; i < 64; ++i)
+		board[i] = MAN(init_color[i], init_piece[i]);
 	side = LIGHT;
 	xside = DARK;
 	castle = 15;
@@ -95,46 +35,175 @@ void init_board()
 	fifty = 0;
 	ply = 0;
 	hply = 0;
-	set_hash();  /* init_hash() must be called before this function */
+	set_hash();
+	set_material();  /* and init_eval() before this one */
+#ifdef USE_NNUE
+	nnue_reset();
+#endif
 	first_move[0] = 0;
 }
 
 
-/* init_hash() initializes the random numbers used by set_hash(). */
+/* board_mask() returns a bitboard of the squares sq for which
+   (board[sq] & mask) == value. Since the board is only 64 bytes, this
+   takes a couple of vector compares, and the callers can then visit
+   just the squares they care about (in the same order as a plain scan
+   of the board) instead of testing all 64. */
 
-void init_hash()
+uint64 board_mask(int mask, int value)
 {
-	int i, j, k;
-
-	srand(0);
-	for (i = 0; i < 2; ++i)
-		for (j = 0; j < 6; ++j)
-			for (k = 0; k < 64; ++k)
-				hash_piece[i][j][k] = hash_rand();
-	hash_side = hash_rand();
+#if defined(BOARD_AVX2)
+	const __m256i m = _mm256_set1_epi8((char)mask);
+	const __m256i v = _mm256_set1_epi8((char)value);
+	__m256i lo = _mm256_loadu_si256((const __m256i *)board);
+	__m256i hi = _mm256_loadu_si256((const __m256i *)(board + 32));
+
+	lo = _mm256_cmpeq_epi8(_mm256_and_si256(lo, m), v);
+	hi = _mm256_cmpeq_epi8(_mm256_and_si256(hi, m), v);
+	return (uint64)(unsigned int)_mm256_movemask_epi8(lo) |
+		((uint64)(unsigned int)_mm256_movemask_epi8(hi) << 32);
+#elif defined(BOARD_SSE2)
+	const __m128i m = _mm_set1_epi8((char)mask);
+	const __m128i v = _mm_set1_epi8((char)value);
+	uint64 r = 0;
+	int i;
+
+	for (i = 0; i < 4; ++i) {
+		__m128i b = _mm_loadu_si128((const __m128i *)(board + 16 * i));
+
+		b = _mm_cmpeq_epi8(_mm_and_si128(b, m), v);
+		r |= (uint64)(unsigned int)_mm_movemask_epi8(b) << (16 * i);
+	}
+	return r;
+#else
+	uint64 r = 0;
+	int i;
+
 	for (i = 0; i < 64; ++i)
-		hash_ep[i] = hash_rand();
+		if ((board[i] & mask) == value)
+			r |= (uint64)1 << i;
+	return r;
+#endif
 }
 
 
-/* hash_rand() XORs some shifted random numbers together to make sure
-   we have good coverage of all 32 bits. (rand() returns 16-bit numbers
-   on some systems.) */
+/* set_fen() sets up the position given in Forsyth-Edwards Notation (or
+   the first four fields of an EPD record). It returns a pointer to the
+   rest of the string, or NULL if s isn't a position we can play, in
+   which case the board is left in an undefined state. gen() and
+   makemove() trust the board, so positions they can't handle (pawns on
+   the first or last rank, the side not to move in check) are refused,
+   and an en passant square no pawn could have just crossed is
+   ignored. */
 
-HashType hash_rand()
+char *set_fen(char *s)
 {
-	int i;
-	HashType r = 0;
+	int i, sq = 0;
+	int kings[2] = { 0, 0 };
+	char *p;
 
-	for (i = 0; i < 32; ++i)
-		r ^= Aleatoire64() << i;
-	return r;
+	while (*s == ' ')
+		++s;
+	for (i = 0; i < 64; ++i) {
+		board[i] = EMPTY_SQ;
+	}
+	for (; *s && *s != ' '; ++s) {
+		if (*s == '/')
+			continue;
+		if (*s >= '1' && *s <= '8') {
+			sq += *s - '0';
+			continue;
+		}
+		p = strchr("PNBRQKpnbrqk", *s);
+		if (!p || sq >= 64)
+			return NULL;
+		board[sq] = MAN((p - "PNBRQKpnbrqk") / 6, (p - "PNBRQKpnbrqk") % 6);
+		if (PIECE(sq) == KING)
+			++kings[COLOR(sq)];
+		if (PIECE(sq) == PAWN && (ROW(sq) == 0 || ROW(sq) == 7))
+			return NULL;
+		++sq;
+	}
+	if (sq != 64 || kings[LIGHT] != 1 || kings[DARK] != 1)
+		return NULL;
+
+	while (*s == ' ')
+		++s;
+	if (*s != 'w' && *s != 'b')
+		return NULL;
+	side = (*s++ == 'w') ? LIGHT : DARK;
+	xside = side ^ 1;
+	if (in_check(xside))
+		return NULL;
+
+	while (*s == ' ')
+		++s;
+	castle = 0;
+	for (; *s && *s != ' '; ++s)
+		switch (*s) {
+			case 'K': castle |= 1; break;
+			case 'Q': castle |= 2; break;
+			case 'k': castle |= 4; break;
+			case 'q': castle |= 8; break;
+		}
+	/* drop the rights the king and rook positions contradict, since
+	   gen() doesn't check for the rook */
+	if (COLOR(E1) != LIGHT || PIECE(E1) != KING)
+		castle &= ~3;
+	if (COLOR(H1) != LIGHT || PIECE(H1) != ROOK)
+		castle &= ~1;
+	if (COLOR(A1) != LIGHT || PIECE(A1) != ROOK)
+		castle &= ~2;
+	if (COLOR(E8) != DARK || PIECE(E8) != KING)
+		castle &= ~12;
+	if (COLOR(H8) != DARK || PIECE(H8) != ROOK)
+		castle &= ~4;
+	if (COLOR(A8) != DARK || PIECE(A8) != ROOK)
+		castle &= ~8;
+
+	while (*s == ' ')
+		++s;
+	ep = -1;
+	if (s[0] >= 'a' && s[0] <= 'h' && s[1] >= '1' && s[1] <= '8') {
+		ep = (s[0] - 'a') + 8 * ('8' - s[1]);
+		s += 2;
+
+		/* the square behind a pawn of xside's that just moved 2 */
+		i = (side == LIGHT) ? ep + 8 : ep - 8;
+		if (ROW(ep) != ((side == LIGHT) ? 2 : 5) || board[ep] != EMPTY_SQ ||
+				board[i] != MAN(xside, PAWN))
+			ep = -1;
+	}
+	else if (*s == '-')
+		++s;
+
+	/* the move counters are optional (EPD doesn't have them) */
+	fifty = 0;
+	while (*s == ' ')
+		++s;
+	if (*s >= '0' && *s <= '9') {
+		fifty = (int)strtol(s, &s, 10);
+		while (*s == ' ')
+			++s;
+		if (*s >= '0' && *s <= '9')
+			strtol(s, &s, 10);
+	}
+
+	ply = 0;
+	hply = 0;
+	set_hash();
+	set_material();
+#ifdef USE_NNUE
+	nnue_reset();
+#endif
+	first_move[0] = 0;
+	return s;
 }
 
 
 /* set_hash() uses the Zobrist method of generating a unique number (hash)
    for the current chess position. Of course, there are many more chess
-   positions than there are 32 bit numbers, so the numbers generated are
+   positions than there are 64 bit numbers, so the numbers generated are
    not really unique, but they're unique enough for our purposes (to detect
    repetitions of the position). 
    The way it works is to XOR random numbers that correspond to features of
@@ -147,11 +216,16 @@ HashType hash_rand()
 void set_hash()
 {
 	int i;
+	uint64 b;
 
 	hash = 0;	
-	for (i = 0; i < 64; ++i)
-		if (color[i] != EMPTY)
-			hash ^= hash_piece[color[i]][piece[i]][i];
+	pawn_hash = 0;
+	for (b = OCCUPIED_MASK(); b; b &= b - 1) {
+		i = LSB(b);
+		hash ^= hash_piece[COLOR(i)][PIECE(i)][i];
+		if (PIECE(i) == PAWN)
+			pawn_hash ^= hash_piece[COLOR(i)][PAWN][i];
+	}
 	if (side == DARK)
 		hash ^= hash_side;
 	if (ep != -1)
@@ -161,11 +235,13 @@ void set_hash()
 HashType get_hash()
 {
 	int i;
+	uint64 b;
 
 	HashType hashTmp = 0; // local
-	for (i = 0; i < 64; ++i)
-		if (color[i] != EMPTY)
-			hashTmp ^= hash_piece[color[i]][piece[i]][i];
+	for (b = OCCUPIED_MASK(); b; b &= b - 1) {
+		i = LSB(b);
+		hashTmp ^= hash_piece[COLOR(i)][PIECE(i)][i];
+	}
 	if (side == DARK)
 		hashTmp ^= hash_side;
 	if (ep != -1)
@@ -175,207 +251,154 @@ HashType get_hash()
 
 
 /* in_check() returns TRUE if side s is in check and FALSE
-   otherwise. It just scans the board to find side s's king
-   and calls attack() to see if it's being attacked. */
+   otherwise. It just finds side s's king and calls attack() to
+   see if it's being attacked. */
 
 BOOL in_check(int s)
 {
-	int i;
+	uint64 b = MAN_MASK(s, KING);
 
-	for (i = 0; i < 64; ++i)
-		if (piece[i] == KING && color[i] == s)
-			return attack(i, s ^ 1);
+	if (b)
+		return attack(LSB(b), s ^ 1);
 	return TRUE;  /* shouldn't get here */
 }
 
 
 /* attack() returns TRUE if square sq is being attacked by side
-   s and FALSE otherwise. */
+   s and FALSE otherwise. The work is done by attack_side(), which is
+   inlined once for each side so that s is a constant in it. */
 
-BOOL attack(int sq, int s)
+static FORCEINLINE BOOL attack_side(int sq, const int s)
 {
 	int i, j, n;
-
-	for (i = 0; i < 64; ++i)
-		if (color[i] == s) {
-			if (piece[i] == PAWN) {
-				if (s == LIGHT) {
-					if (COL(i) != 0 && i - 9 == sq)
-						return TRUE;
-					if (COL(i) != 7 && i - 7 == sq)
-						return TRUE;
-				}
-				else {
-					if (COL(i) != 0 && i + 7 == sq)
-						return TRUE;
-					if (COL(i) != 7 && i + 9 == sq)
+	uint64 b;
+	const int d = (s == LIGHT) ? -8 : 8;  /* the direction s's pawns move in */
+
+	for (b = SIDE_MASK(s); b; b &= b - 1) {
+		i = LSB(b);
+		if (PIECE(i) == PAWN) {
+			if (COL(i) != 0 && i + d - 1 == sq)
+				return TRUE;
+			if (COL(i) != 7 && i + d + 1 == sq)
+				return TRUE;
+		}
+		else
+			for (j = 0; j < offsets[PIECE(i)]; ++j)
+				for (n = i;;) {
+					n = mailbox[mailbox64[n] + offset[PIECE(i)][j]];
+					if (n == -1)
+						break;
+					if (n == sq)
 						return TRUE;
+					if (COLOR(n) != EMPTY)
+						break;
+					if (!slide[PIECE(i)])
+						break;
 				}
-			}
-			else
-				for (j = 0; j < offsets[piece[i]]; ++j)
-					for (n = i;;) {
-						n = mailbox[mailbox64[n] + offset[piece[i]][j]];
-						if (n == -1)
-							break;
-						if (n == sq)
-							return TRUE;
-						if (color[n] != EMPTY)
-							break;
-						if (!slide[piece[i]])
-							break;
-					}
-		}
+	}
 	return FALSE;
 }
 
+BOOL attack(int sq, int s)
+{
+	if (s == LIGHT)
+		return attack_side(sq, LIGHT);
+	return attack_side(sq, DARK);
+}
 
-/* gen() generates pseudo-legal moves for the current position.
-   It scans the board to find friendly pieces and then determines
-   what squares they attack. When it finds a piece/square
+
+/* gen_side() generates pseudo-legal moves for side s, which is the
+   side to move. It scans the board to find friendly pieces and then
+   determines what squares they attack. When it finds a piece/square
    combination, it calls gen_push to put the move on the "move
-   stack." */
+   stack." If caps is TRUE, it only generates capture and promote
+   moves, for the quiescence search.
+   gen_side() is always inlined with constant arguments, so each of
+   gen() and gen_caps() gets its own copy for each side, with the pawn
+   direction, promotion rank, and castle squares folded in. */
 
-void gen()
+static FORCEINLINE void gen_side(const int s, const BOOL caps)
 {
 	int i, j, n;
+	uint64 b;
+	const int xs = s ^ 1;
+	const int d = (s == LIGHT) ? -8 : 8;  /* the direction our pawns move in */
+	const int k = (s == LIGHT) ? E1 : E8;  /* where our king castles from */
 
 	/* so far, we have no moves for the current ply */
 	first_move[ply + 1] = first_move[ply];
 
-	for (i = 0; i < 64; ++i)
-		if (color[i] == side) {
-			if (piece[i] == PAWN) {
-				if (side == LIGHT) {
-					if (COL(i) != 0 && color[i - 9] == DARK)
-						gen_push(i, i - 9, 17);
-					if (COL(i) != 7 && color[i - 7] == DARK)
-						gen_push(i, i - 7, 17);
-					if (color[i - 8] == EMPTY) {
-						gen_push(i, i - 8, 16);
-						if (i >= 48 && color[i - 16] == EMPTY)
-							gen_push(i, i - 16, 24);
-					}
-				}
-				else {
-					if (COL(i) != 0 && color[i + 7] == LIGHT)
-						gen_push(i, i + 7, 17);
-					if (COL(i) != 7 && color[i + 9] == LIGHT)
-						gen_push(i, i + 9, 17);
-					if (color[i + 8] == EMPTY) {
-						gen_push(i, i + 8, 16);
-						if (i <= 15 && color[i + 16] == EMPTY)
-							gen_push(i, i + 16, 24);
-					}
-				}
+	for (b = SIDE_MASK(s); b; b &= b - 1) {
+		i = LSB(b);
+		if (PIECE(i) == PAWN) {
+			if (COL(i) != 0 && COLOR(i + d - 1) == xs)
+				gen_push(i, i + d - 1, 17);
+			if (COL(i) != 7 && COLOR(i + d + 1) == xs)
+				gen_push(i, i + d + 1, 17);
+			if (COLOR(i + d) == EMPTY) {
+				if (!caps || ROW(i + d) == ((s == LIGHT) ? 0 : 7))
+					gen_push(i, i + d, 16);
+				if (!caps && ROW(i) == ((s == LIGHT) ? 6 : 1) &&
+						COLOR(i + 2 * d) == EMPTY)
+					gen_push(i, i + 2 * d, 24);
 			}
-			else
-				for (j = 0; j < offsets[piece[i]]; ++j)
-					for (n = i;;) {
-						n = mailbox[mailbox64[n] + offset[piece[i]][j]];
-						if (n == -1)
-							break;
-						if (color[n] != EMPTY) {
-							if (color[n] == xside)
-								gen_push(i, n, 1);
-							break;
-						}
-						gen_push(i, n, 0);
-						if (!slide[piece[i]])
-							break;
-					}
 		}
+		else
+			for (j = 0; j < offsets[PIECE(i)]; ++j)
+				for (n = i;;) {
+					n = mailbox[mailbox64[n] + offset[PIECE(i)][j]];
+					if (n == -1)
+						break;
+					if (COLOR(n) != EMPTY) {
+						if (COLOR(n) == xs)
+							gen_push(i, n, 1);
+						break;
+					}
+					if (!caps)
+						gen_push(i, n, 0);
+					if (!slide[PIECE(i)])
+						break;
+				}
+	}
 
 	/* generate castle moves */
-	if (side == LIGHT) {
-		if (castle & 1)
-			gen_push(E1, G1, 2);
-		if (castle & 2)
-			gen_push(E1, C1, 2);
+	if (!caps) {
+		if (castle & ((s == LIGHT) ? 1 : 4))
+			gen_push(k, k + 2, 2);
+		if (castle & ((s == LIGHT) ? 2 : 8))
+			gen_push(k, k - 2, 2);
 	}
-	else {
-		if (castle & 4)
-			gen_push(E8, G8, 2);
-		if (castle & 8)
-			gen_push(E8, C8, 2);
-	}
-	
+
 	/* generate en passant moves */
 	if (ep != -1) {
-		if (side == LIGHT) {
-			if (COL(ep) != 0 && color[ep + 7] == LIGHT && piece[ep + 7] == PAWN)
-				gen_push(ep + 7, ep, 21);
-			if (COL(ep) != 7 && color[ep + 9] == LIGHT && piece[ep + 9] == PAWN)
-				gen_push(ep + 9, ep, 21);
-		}
-		else {
-			if (COL(ep) != 0 && color[ep - 9] == DARK && piece[ep - 9] == PAWN)
-				gen_push(ep - 9, ep, 21);
-			if (COL(ep) != 7 && color[ep - 7] == DARK && piece[ep - 7] == PAWN)
-				gen_push(ep - 7, ep, 21);
-		}
+		if (COL(ep) != 0 && COLOR(ep - d - 1) == s && PIECE(ep - d - 1) == PAWN)
+			gen_push(ep - d - 1, ep, 21);
+		if (COL(ep) != 7 && COLOR(ep - d + 1) == s && PIECE(ep - d + 1) == PAWN)
+			gen_push(ep - d + 1, ep, 21);
 	}
 }
 
 
-/* gen_caps() is basically a copy of gen() that's modified to
-   only generate capture and promote moves. It's used by the
-   quiescence search. */
+/* gen() generates pseudo-legal moves for the current position. */
 
-void gen_caps()
+void gen()
 {
-	int i, j, n;
+	if (side == LIGHT)
+		gen_side(LIGHT, FALSE);
+	else
+		gen_side(DARK, FALSE);
+}
 
-	first_move[ply + 1] = first_move[ply];
-	for (i = 0; i < 64; ++i)
-		if (color[i] == side) {
-			if (piece[i]==PAWN) {
-				if (side == LIGHT) {
-					if (COL(i) != 0 && color[i - 9] == DARK)
-						gen_push(i, i - 9, 17);
-					if (COL(i) != 7 && color[i - 7] == DARK)
-						gen_push(i, i - 7, 17);
-					if (i <= 15 && color[i - 8] == EMPTY)
-						gen_push(i, i - 8, 16);
-				}
-				if (side == DARK) {
-					if (COL(i) != 0 && color[i + 7] == LIGHT)
-						gen_push(i, i + 7, 17);
-					if (COL(i) != 7 && color[i + 9] == LIGHT)
-						gen_push(i, i + 9, 17);
-					if (i >= 48 && color[i + 8] == EMPTY)
-						gen_push(i, i + 8, 16);
-				}
-			}
-			else
-				for (j = 0; j < offsets[piece[i]]; ++j)
-					for (n = i;;) {
-						n = mailbox[mailbox64[n] + offset[piece[i]][j]];
-						if (n == -1)
-							break;
-						if (color[n] != EMPTY) {
-							if (color[n] == xside)
-								gen_push(i, n, 1);
-							break;
-						}
-						if (!slide[piece[i]])
-							break;
-					}
-		}
-	if (ep != -1) {
-		if (side == LIGHT) {
-			if (COL(ep) != 0 && color[ep + 7] == LIGHT && piece[ep + 7] == PAWN)
-				gen_push(ep + 7, ep, 21);
-			if (COL(ep) != 7 && color[ep + 9] == LIGHT && piece[ep + 9] == PAWN)
-				gen_push(ep + 9, ep, 21);
-		}
-		else {
-			if (COL(ep) != 0 && color[ep - 9] == DARK && piece[ep - 9] == PAWN)
-				gen_push(ep - 9, ep, 21);
-			if (COL(ep) != 7 && color[ep - 7] == DARK && piece[ep - 7] == PAWN)
-				gen_push(ep - 7, ep, 21);
-		}
-	}
+
+/* gen_caps() only generates capture and promote moves. It's used
+   by the quiescence search. */
+
+void gen_caps()
+{
+	if (side == LIGHT)
+		gen_side(LIGHT, TRUE);
+	else
+		gen_side(DARK, TRUE);
 }
 
 
@@ -390,50 +413,175 @@ void gen_caps()
 
 void gen_push(int from, int to, int bits)
 {
-	gen_t *g;
+	int i;
 	
-	if (bits & 16) {
-		if (side == LIGHT) {
-			if (to <= H8) {
-				gen_promote(from, to, bits);
-				return;
-			}
-		}
-		else {
-			if (to >= A1) {
-				gen_promote(from, to, bits);
-				return;
-			}
-		}
+	/* a pawn can only reach the last rank of its own side's
+	   opponent, so there's no need to look at the side to move */
+	if ((bits & 16) && (to <= H8 || to >= A1)) {
+		gen_promote(from, to);
+		return;
 	}
-	g = &gen_dat[first_move[ply + 1]++];
-	g->m.b.from = (char)from;
-	g->m.b.to = (char)to;
-	g->m.b.promote = 0;
-	g->m.b.bits = (char)bits;
-	if (color[to] != EMPTY)
-		g->score = 1000000 + (piece[to] * 10) - piece[from];
+	i = first_move[ply + 1]++;
+	gen_move[i] = MOVE(from, to, 0);
+	if (COLOR(to) != EMPTY)
+		gen_score[i] = 1000000 + (PIECE(to) * 10) - PIECE(from);
 	else
-		g->score = history[from][to];
+		gen_score[i] = history[from][to];
 }
 
 
 /* gen_promote() is just like gen_push(), only it puts 4 moves
    on the move stack, one for each possible promotion piece */
 
-void gen_promote(int from, int to, int bits)
+void gen_promote(int from, int to)
 {
-	int i;
-	gen_t *g;
+	int i, j;
 	
 	for (i = KNIGHT; i <= QUEEN; ++i) {
-		g = &gen_dat[first_move[ply + 1]++];
-		g->m.b.from = (char)from;
-		g->m.b.to = (char)to;
-		g->m.b.promote = (char)i;
-		g->m.b.bits = (char)(bits | 32);
-		g->score = 1000000 + (i * 10);
+		j = first_move[ply + 1]++;
+		gen_move[j] = MOVE(from, to, i);
+		gen_score[j] = 1000000 + (i * 10);
+	}
+}
+
+
+/* move_bits() returns the bitfield that describes move m (see
+   defs.h). It has to be called before m is made, since it
+   looks at the men on m's squares. */
+
+int move_bits(move m)
+{
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+	int bits = (COLOR(to) != EMPTY) ? 1 : 0;
+
+	if (PIECE(from) == PAWN) {
+		bits |= 16;
+		if (to - from == 16 || from - to == 16)
+			bits |= 8;
+		else if (COL(to) != COL(from) && COLOR(to) == EMPTY)
+			bits |= 5;  /* a diagonal move to an empty square */
+		if (MOVE_PROMOTE(m))
+			bits |= 32;
 	}
+	else if (PIECE(from) == KING && (from == E1 || from == E8) &&
+			(to - from == 2 || from - to == 2))
+		bits |= 2;
+	return bits;
+}
+
+
+/* pseudo_legal() returns TRUE if m is a move that gen() could have
+   generated in the current position. Moves coming out of the hash
+   table may belong to another position whose key collided with this
+   one, so they have to be checked before being played without a
+   move list to compare against. Like gen(), it doesn't care whether
+   the move leaves the king in check; makemove() handles that. */
+
+BOOL pseudo_legal(move m)
+{
+	int from, to, promote, bits, p, d, j, n;
+	BOOL promo;
+
+	from = MOVE_FROM(m);
+	to = MOVE_TO(m);
+	promote = MOVE_PROMOTE(m);
+	if (COLOR(from) != side || COLOR(to) == side)
+		return FALSE;
+	p = PIECE(from);
+	bits = move_bits(m);
+
+	/* castling: the king must be on its original square and the
+	   permission bit must still be set. The squares in between and
+	   the attacks are tested by makemove(). */
+	if (bits & 2) {
+		if (p != KING || bits != 2 || promote)
+			return FALSE;
+		if (side == LIGHT)
+			return from == E1 && ((to == G1 && (castle & 1)) ||
+					(to == C1 && (castle & 2)));
+		return from == E8 && ((to == G8 && (castle & 4)) ||
+				(to == C8 && (castle & 8)));
+	}
+
+	if (p == PAWN) {
+		if (!(bits & 16))
+			return FALSE;
+
+		/* the promote bit has to agree with the destination rank */
+		promo = (side == LIGHT) ? (to <= H8) : (to >= A1);
+		if (promo != ((bits & 32) != 0))
+			return FALSE;
+		if (promo ? (promote < KNIGHT || promote > QUEEN) : promote)
+			return FALSE;
+
+		d = (side == LIGHT) ? -8 : 8;
+		switch (bits & ~32) {
+			case 16:
+				return to == from + d && COLOR(to) == EMPTY;
+			case 24:
+				return to == from + 2 * d && COLOR(from + d) == EMPTY &&
+						COLOR(to) == EMPTY &&
+						((side == LIGHT) ? (from >= 48) : (from <= 15));
+			case 17:
+				if (COLOR(to) != xside)
+					return FALSE;
+				break;
+			case 21:
+				if (to != ep)
+					return FALSE;
+				break;
+			default:
+				return FALSE;
+		}
+		return (COL(from) != 0 && to == from + d - 1) ||
+				(COL(from) != 7 && to == from + d + 1);
+	}
+
+	/* a piece move is either a plain move to an empty square or
+	   a capture, never anything fancier */
+	if (promote || bits != ((COLOR(to) == EMPTY) ? 0 : 1))
+		return FALSE;
+	for (j = 0; j < offsets[p]; ++j)
+		for (n = from;;) {
+			n = mailbox[mailbox64[n] + offset[p][j]];
+			if (n == -1)
+				break;
+			if (n == to)
+				return TRUE;
+			if (COLOR(n) != EMPTY)
+				break;
+			if (!slide[p])
+				break;
+		}
+	return FALSE;
+}
+
+
+/* add_mat() and sub_mat() update piece_mat, pawn_mat, and pcsq_mat
+   when a man of color c and type p appears on or leaves square sq.
+   Since they know when a pawn moves, they also keep pawn_hash. */
+
+static void add_mat(int c, int p, int sq)
+{
+	if (p == PAWN) {
+		pawn_mat[c] += piece_value[PAWN];
+		pawn_hash ^= hash_piece[c][PAWN][sq];
+	}
+	else
+		piece_mat[c] += piece_value[p];
+	pcsq_mat[c] += pcsq[c][p][sq];
+}
+
+static void sub_mat(int c, int p, int sq)
+{
+	if (p == PAWN) {
+		pawn_mat[c] -= piece_value[PAWN];
+		pawn_hash ^= hash_piece[c][PAWN][sq];
+	}
+	else
+		piece_mat[c] -= piece_value[p];
+	pcsq_mat[c] -= pcsq[c][p][sq];
 }
 
 
@@ -441,68 +589,81 @@ void gen_promote(int from, int to, int bits)
    undoes whatever it did and returns FALSE. Otherwise, it
    returns TRUE. */
 
-BOOL makemove(move_bytes m)
+BOOL makemove(move m)
 {
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+	int bits = move_bits(m);
+
 #ifdef USE_FAST_HASH
 	hist_dat[hply].hash = hash; //  Sauvegarde du hash de la position. A faire avant les modifs de roque...
 #endif
-	ASSERT(piece[m.from]!=EMPTY);
+	hist_dat[hply].pawn_hash = pawn_hash;
+	/* same for the material sums, which the castle code below changes */
+	hist_dat[hply].piece_mat[LIGHT] = piece_mat[LIGHT];
+	hist_dat[hply].piece_mat[DARK] = piece_mat[DARK];
+	hist_dat[hply].pawn_mat[LIGHT] = pawn_mat[LIGHT];
+	hist_dat[hply].pawn_mat[DARK] = pawn_mat[DARK];
+	hist_dat[hply].pcsq_mat[LIGHT] = pcsq_mat[LIGHT];
+	hist_dat[hply].pcsq_mat[DARK] = pcsq_mat[DARK];
+	ASSERT(PIECE(from)!=EMPTY);
 
 	/* test to see if a castle move is legal and move the rook
 	   (the king is moved with the usual move code later) */
-	if (m.bits & 2) {
-		int from, to;
+	if (bits & 2) {
+		int rook_from, rook_to;
 
 		if (in_check(side))
 			return FALSE;
-		switch (m.to) {
+		switch (to) {
 			case 62:
-				if (color[F1] != EMPTY || color[G1] != EMPTY ||
+				if (COLOR(F1) != EMPTY || COLOR(G1) != EMPTY ||
 						attack(F1, xside) || attack(G1, xside))
 					return FALSE;
-				from = H1;
-				to = F1;
+				rook_from = H1;
+				rook_to = F1;
 				break;
 			case 58:
-				if (color[B1] != EMPTY || color[C1] != EMPTY || color[D1] != EMPTY ||
+				if (COLOR(B1) != EMPTY || COLOR(C1) != EMPTY || COLOR(D1) != EMPTY ||
 						attack(C1, xside) || attack(D1, xside))
 					return FALSE;
-				from = A1;
-				to = D1;
+				rook_from = A1;
+				rook_to = D1;
 				break;
 			case 6:
-				if (color[F8] != EMPTY || color[G8] != EMPTY ||
+				if (COLOR(F8) != EMPTY || COLOR(G8) != EMPTY ||
 						attack(F8, xside) || attack(G8, xside))
 					return FALSE;
-				from = H8;
-				to = F8;
+				rook_from = H8;
+				rook_to = F8;
 				break;
 			case 2:
-				if (color[B8] != EMPTY || color[C8] != EMPTY || color[D8] != EMPTY ||
+				if (COLOR(B8) != EMPTY || COLOR(C8) != EMPTY || COLOR(D8) != EMPTY ||
 						attack(C8, xside) || attack(D8, xside))
 					return FALSE;
-				from = A8;
-				to = D8;
+				rook_from = A8;
+				rook_to = D8;
 				break;
 			default:  /* shouldn't get here */
-				from = -1;
-				to = -1;
+				rook_from = -1;
+				rook_to = -1;
 				break;
 		}
 		// MAJ HASH
 #ifdef USE_FAST_HASH
-		hash ^=hash_piece[side][ROOK][from]^// On enlve la tour de from
-		       hash_piece[side][ROOK][to];  // On pose la tour dans to
+		hash ^=hash_piece[side][ROOK][rook_from]^// On enlve la tour de rook_from
+		       hash_piece[side][ROOK][rook_to];  // On pose la tour dans rook_to
 #endif
-		color[to] = color[from];
-		piece[to] = piece[from];
-		color[from] = EMPTY;
-		piece[from] = EMPTY;
+		sub_mat(side, ROOK, rook_from);
+		add_mat(side, ROOK, rook_to);
+		board[rook_to] = board[rook_from];
+		board[rook_from] = EMPTY_SQ;
 	}
 
 	/* back up information so we can take the move back later. */
-	hist_dat[hply].m.b = m;
-	hist_dat[hply].capture = piece[(int)m.to];
+	hist_dat[hply].m = m;
+	hist_dat[hply].bits = bits;
+	hist_dat[hply].capture = PIECE(to);
 	hist_dat[hply].castle = castle;
 	hist_dat[hply].ep = ep;
 	hist_dat[hply].fifty = fifty;
@@ -514,15 +675,12 @@ BOOL makemove(move_bytes m)
 
 	/* update the castle, en passant, and
 	   fifty-move-draw variables */
-	castle &= castle_mask[(int)m.from] & castle_mask[(int)m.to];
+	castle &= castle_mask[from] & castle_mask[to];
 #ifdef USE_FAST_HASH
 	if (ep != -1) hash ^= hash_ep[ep]; // On supprime l'ancien flag ep s'il y en avait 1
 #endif
-	if (m.bits & 8) {
-		if (side == LIGHT)
-			ep = m.to + 8;
-		else
-			ep = m.to - 8;
+	if (bits & 8) {
+		ep = to - pawn_push[side];
 #ifdef USE_FAST_HASH
 		ASSERT(ep != -1);
 		hash ^= hash_ep[ep]; // Nouveau flag ep ?
@@ -530,48 +688,43 @@ BOOL makemove(move_bytes m)
 	}
 	else
 		ep = -1;
-	if (m.bits & 17)
+	if (bits & 17)
 		fifty = 0;
 	else
 		++fifty;
 
 #ifdef USE_FAST_HASH
-	if (piece[m.to] != EMPTY)                                  // Capture rgulire de pice ?
-		hash ^= hash_piece[xside][piece[(int)m.to]][(int)m.to];// On supprime la pice capture 
+	if (PIECE(to) != EMPTY)                                  // Capture rgulire de pice ?
+		hash ^= hash_piece[xside][PIECE(to)][to];// On supprime la pice capture 
 #endif
+	if (PIECE(to) != EMPTY)
+		sub_mat(xside, PIECE(to), to);
 
     /* move the piece */
-	color[(int)m.to] = side;
-	if (m.bits & 32)
-		piece[(int)m.to] = m.promote;
+	if (bits & 32)
+		board[to] = MAN(side, MOVE_PROMOTE(m));
 	else
-		piece[(int)m.to] = piece[(int)m.from];
+		board[to] = board[from];
 
 #ifdef USE_FAST_HASH
-    // A cet endroit du code, piece[(int)m.to] est soit la pice venant de from ou une pice qui a t promue (Cf. code juste au-dessus)
-	// et piece[(int)m.from] n'a pas encore t mise  "EMPTY".
-	hash ^= hash_piece[side][piece[(int)m.to]][(int)m.to]^// On pose la pice qui doit se trouver dans la case m.to (capture ou promue)
-	        hash_piece[side][piece[(int)m.from]][(int)m.from];// On supprime la pice de de la case from 
+    // A cet endroit du code, PIECE(to) est soit la pice venant de from ou une pice qui a t promue (Cf. code juste au-dessus)
+	// et PIECE(from) n'a pas encore t mise  "EMPTY".
+	hash ^= hash_piece[side][PIECE(to)][to]^// On pose la pice qui doit se trouver dans la case to (capture ou promue)
+	        hash_piece[side][PIECE(from)][from];// On supprime la pice de de la case from 
 #endif
-	color[(int)m.from] = EMPTY;
-	piece[(int)m.from] = EMPTY;
+	sub_mat(side, PIECE(from), from);
+	add_mat(side, PIECE(to), to);
+	board[from] = EMPTY_SQ;
 
 	/* erase the pawn if this is an en passant move */
-	if (m.bits & 4) {
-		if (side == LIGHT) {
-#ifdef USE_FAST_HASH
-			hash ^= hash_piece[DARK][PAWN][m.to + 8];// On supprime le pion de la prise en passant
-#endif
-			color[m.to + 8] = EMPTY;
-			piece[m.to + 8] = EMPTY;
-		}
-		else {
+	if (bits & 4) {
+		int sq = to - pawn_push[side];  /* the square the pawn is on */
+
 #ifdef USE_FAST_HASH
-			hash ^= hash_piece[LIGHT][PAWN][m.to - 8];// On supprime le pion de la prise en passant
+		hash ^= hash_piece[xside][PAWN][sq];// On supprime le pion de la prise en passant
 #endif
-			color[m.to - 8] = EMPTY;
-			piece[m.to - 8] = EMPTY;
-		}
+		board[sq] = EMPTY_SQ;
+		sub_mat(xside, PAWN, sq);
 	}
 
 	/* switch sides and test for legality (if we can capture
@@ -590,6 +743,9 @@ BOOL makemove(move_bytes m)
 	ASSERT(hash == get_hash());
 #else
 	set_hash();// ancienne mthode
+#endif
+#ifdef USE_NNUE
+	nnue_make();
 #endif
 	return TRUE;
 }
@@ -599,121 +755,270 @@ BOOL makemove(move_bytes m)
 
 void takeback()
 {
-	move_bytes m;
+	int from, to, bits;
 
 	side ^= 1;
 	xside ^= 1;
 	--ply;
 	--hply;
-	m = hist_dat[hply].m.b;
+	from = MOVE_FROM(hist_dat[hply].m);
+	to = MOVE_TO(hist_dat[hply].m);
+	bits = hist_dat[hply].bits;
 	castle = hist_dat[hply].castle;
 	ep = hist_dat[hply].ep;
 	fifty = hist_dat[hply].fifty;
 	hash = hist_dat[hply].hash;
-	color[(int)m.from] = side;
-	if (m.bits & 32)
-		piece[(int)m.from] = PAWN;
+	pawn_hash = hist_dat[hply].pawn_hash;
+	piece_mat[LIGHT] = hist_dat[hply].piece_mat[LIGHT];
+	piece_mat[DARK] = hist_dat[hply].piece_mat[DARK];
+	pawn_mat[LIGHT] = hist_dat[hply].pawn_mat[LIGHT];
+	pawn_mat[DARK] = hist_dat[hply].pawn_mat[DARK];
+	pcsq_mat[LIGHT] = hist_dat[hply].pcsq_mat[LIGHT];
+	pcsq_mat[DARK] = hist_dat[hply].pcsq_mat[DARK];
+	if (bits & 32)
+		board[from] = MAN(side, PAWN);
 	else
-		piece[(int)m.from] = piece[(int)m.to];
-	if (hist_dat[hply].capture == EMPTY) {
-		color[(int)m.to] = EMPTY;
-		piece[(int)m.to] = EMPTY;
-	}
-	else {
-		color[(int)m.to] = xside;
-		piece[(int)m.to] = hist_dat[hply].capture;
-	}
-	if (m.bits & 2) {
-		int from, to;
+		board[from] = board[to];
+	if (hist_dat[hply].capture == EMPTY)
+		board[to] = EMPTY_SQ;
+	else
+		board[to] = MAN(xside, hist_dat[hply].capture);
+	if (bits & 2) {
+		int rook_from, rook_to;
 
-		switch(m.to) {
+		switch(to) {
 			case 62:
-				from = F1;
-				to = H1;
+				rook_from = F1;
+				rook_to = H1;
 				break;
 			case 58:
-				from = D1;
-				to = A1;
+				rook_from = D1;
+				rook_to = A1;
 				break;
 			case 6:
-				from = F8;
-				to = H8;
+				rook_from = F8;
+				rook_to = H8;
 				break;
 			case 2:
-				from = D8;
-				to = A8;
+				rook_from = D8;
+				rook_to = A8;
 				break;
 			default:  /* shouldn't get here */
-				from = -1;
-				to = -1;
+				rook_from = -1;
+				rook_to = -1;
 				break;
 		}
-		color[to] = side;
-		piece[to] = ROOK;
-		color[from] = EMPTY;
-		piece[from] = EMPTY;
+		board[rook_to] = MAN(side, ROOK);
+		board[rook_from] = EMPTY_SQ;
 	}
-	if (m.bits & 4) {
-		if (side == LIGHT) {
-			color[m.to + 8] = xside;
-			piece[m.to + 8] = PAWN;
-		}
-		else {
-			color[m.to - 8] = xside;
-			piece[m.to - 8] = PAWN;
-		}
+	if (bits & 4) {
+		board[to - pawn_push[side]] = MAN(xside, PAWN);
 	}
 }
 
 
 
 
+/* The hash table. Each bucket holds HT_WAYS entries and the top 32 bits
+   of their positions' keys (see HT_KEY()); the bucket itself is chosen
+   by the rest of the key. Keeping the keys apart lets an entry fit in 8
+   bytes, so the table holds more positions in the same memory.
+   tt_find() returns the index of the current position's entry in bucket
+   b, or -1 if it isn't there. */
+
+#ifdef HASH_STATS
+static HashType HT_full[HT_BUCKETS][HT_WAYS];  /* the full key of each entry */
+#endif
+
+static int tt_find(HtBucket *b, unsigned int k)
+{
+	int i;
+
+	for (i = 0; i < HT_WAYS; ++i)
+		if (b->key[i] == k && (b->entry[i].flag & FLAG_MASK))
+			return i;
+	return -1;
+}
+
+/* tt_replace() returns the index of the entry of bucket b that a new
+   position should take over: an empty one if there is one, otherwise
+   the shallowest one, preferring entries left by earlier searches. */
+
+static int tt_replace(HtBucket *b)
+{
+	int i, v;
+	int r = 0;  /* the entry to replace */
+	int rv = 1000;  /* ...and how much we'd like to keep it */
+
+	for (i = 0; i < HT_WAYS; ++i) {
+		if (!(b->entry[i].flag & FLAG_MASK))
+			return i;
+		v = b->entry[i].depth;
+		if ((b->entry[i].flag & ~FLAG_MASK) != tt_age)
+			v -= 256;
+		if (v < rv) {
+			rv = v;
+			r = i;
+		}
+	}
+	return r;
+}
+
 HtTyp *getTT()
 {
+	HtBucket *b;
 	HtTyp *pTransp;
-	pTransp = &HT[hash % (HT_SIZE - 1)];
+	int i;
+
+	if (tuning)
+		return NULL;
+	b = &tt_table[hash % tt_buckets];
+	++tt_probes;
+	i = tt_find(b, HT_KEY(hash));
+	if (i == -1)
+		return NULL;
+	++tt_hits;
+#ifdef HASH_STATS
+	if (HT_full[b - HT][i] != hash)
+		++tt_collisions;
+#endif
 
-	if (pTransp->hash == hash)
-		return pTransp;
-	return NULL;
+	/* the entry is still useful, so it belongs to this search now */
+	pTransp = &b->entry[i];
+	pTransp->flag = (pTransp->flag & FLAG_MASK) | tt_age;
+	return pTransp;
 }
 
 void putTT(int depth, int eval, move m, int alpha, int beta)
 {
+	HtBucket *b;
 	HtTyp *pTransp;
-	pTransp = &HT[hash % (HT_SIZE - 1)];
+	unsigned int k;
+	unsigned char keep;
+	int i;
 
-	if (pTransp->depth<=depth)
+	if (tuning)
+		return;
+	b = &tt_table[hash % tt_buckets];
+	k = HT_KEY(hash);
+	i = tt_find(b, k);
+	if (i != -1) {
+		pTransp = &b->entry[i];
+		if (pTransp->depth > depth)
+			return;
+
+		// La valeur statique reste valable si c'est la meme position
+		keep = (unsigned char)((pTransp->flag & FLAG_EVAL) | tt_age);
+	}
+	else {
+		i = tt_replace(b);
+		STATS(if (b->entry[i].flag & FLAG_MASK) ++tt_overwrites);
+		b->key[i] = k;
+#ifdef HASH_STATS
+		HT_full[b - HT][i] = hash;
+#endif
+		pTransp = &b->entry[i];
+		keep = tt_age;
+	}
+	STATS(++tt_stores);
+
+	pTransp->depth = depth;
+	pTransp->move = m;
+	
+	if (eval <= alpha)
 	{
-		pTransp->hash = hash;
-		pTransp->depth = depth;
-		pTransp->move = m;
-		
-		if (eval <= alpha)
+		pTransp->flag = FLAG_U_BOUND | keep;
+		SCALE_MATE_VALUE(eval);
+		pTransp->score = eval;
+	}
+	else
+	{
+		if (eval >= beta)
 		{
-			pTransp->flag = FLAG_U_BOUND;
+			pTransp->flag = FLAG_L_BOUND | keep;
 			SCALE_MATE_VALUE(eval);
 			pTransp->score = eval;
 		}
 		else
 		{
-			if (eval >= beta)
-			{
-				pTransp->flag = FLAG_L_BOUND;
-				SCALE_MATE_VALUE(eval);
-				pTransp->score = eval;
-			}
-			else
-			{
-				SCALE_MATE_VALUE(eval);
-				pTransp->score = eval;
-				pTransp->flag = FLAG_VALID;
-			}
+			SCALE_MATE_VALUE(eval);
+			pTransp->score = eval;
+			pTransp->flag = FLAG_VALID | keep;
 		}
 	}
 }
 
+/* putTTEval() records the static evaluation of the current position in
+   its hash table entry, so the next visit doesn't have to call eval().
+   If the position has no entry, it only takes one over that doesn't
+   hold a result of the current search. */
+
+void putTTEval(int eval)
+{
+	HtBucket *b;
+	HtTyp *pTransp;
+	unsigned int k;
+	int i;
+
+	if (tuning)
+		return;
+	b = &tt_table[hash % tt_buckets];
+	k = HT_KEY(hash);
+	i = tt_find(b, k);
+	if (i != -1)
+		pTransp = &b->entry[i];
+	else {
+		i = tt_replace(b);
+		pTransp = &b->entry[i];
+		if (pTransp->depth > 0 && (pTransp->flag & ~FLAG_MASK) == tt_age)
+			return;
+		STATS(if (pTransp->flag & FLAG_MASK) ++tt_overwrites);
+		b->key[i] = k;
+#ifdef HASH_STATS
+		HT_full[b - HT][i] = hash;
+#endif
+		pTransp->move = 0;
+		pTransp->score = 0;
+		pTransp->depth = 0;
+		pTransp->flag = tt_age;
+	}
+	pTransp->eval = (short)eval;
+	pTransp->flag |= FLAG_EVAL;
+}
+
+/* tt_move() returns the move of hash table entry e if it can be played
+   in the current position, or 0 if there's none. A move that can't be
+   played means that the entry belongs to another position. */
+
+move tt_move(HtTyp *e)
+{
+	if (!e->move)
+		return 0;
+	if (pseudo_legal(e->move))
+		return e->move;
+	++tt_bad_moves;
+	return 0;
+}
+
+/* tt_hashfull() returns how full the hash table is, in permille: the
+   share of the entries of its first 1000 buckets that the current
+   search has used */
+
+int tt_hashfull()
+{
+	unsigned int i, n = 0;
+	unsigned int buckets = (tt_buckets < 1000) ? tt_buckets : 1000;
+	int j;
+
+	for (i = 0; i < buckets; ++i)
+		for (j = 0; j < HT_WAYS; ++j)
+			if ((tt_table[i].entry[j].flag & FLAG_MASK) &&
+					(tt_table[i].entry[j].flag & ~FLAG_MASK) == tt_age)
+				++n;
+	return (int)(n * 1000 / (buckets * HT_WAYS));
+}
+
 void initHT()
 {
-	memset(HT, 0, sizeof(HT));
+	memset(tt_table, 0, tt_buckets * sizeof(HtBucket));
 }
\ No newline at end of file
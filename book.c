@@ -6,39 +6,176 @@
  */
 
 
+/* The opening book is a binary file laid out like a Polyglot book:
+   16-byte entries, each with a position's key, a move, and the move's
+   weight, stored big-endian and sorted by key. open_book() maps the file
+   into memory and book_move() finds a position's moves with a binary
+   search, so a lookup costs a few cache misses however big the book is,
+   and positions reached by transposition are found too.
+
+   The keys are made with our hash keys (see book_key()), not with
+   Polyglot's, so a Polyglot book would never match a position. To tell
+   our books from those, the first entry of the file is a header: key 0,
+   no move, weight 0, and BOOK_MAGIC where the learn field goes, which
+   sorts first and is never played. open_book() refuses a file without
+   it. The book is made from BOOK_TEXT (lines of moves in coordinate
+   notation) the first time the program starts without BOOK_FILE. */
+
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include "defs.h"
 #include "data.h"
 #include "protos.h"
 
 
-/* the opening book file, declared here so we don't have to include stdio.h in
-   a header file */
-FILE *book_file;
+#define BOOK_ENTRY_SIZE		16
+
+/* the mapped book file and its number of entries */
+static unsigned char *book;
+static int book_entries;
+#ifdef _WIN32
+static HANDLE book_map;
+#endif
+
 
+/* get_be() and put_be() read and write the n-byte big-endian number at p */
 
-/* open_book() opens the opening book file and initializes the random number
-   generator so we play random book moves. */
+static uint64 get_be(const unsigned char *p, int n)
+{
+	uint64 x = 0;
+	int i;
+
+	for (i = 0; i < n; ++i)
+		x = (x << 8) | p[i];
+	return x;
+}
+
+static void put_be(unsigned char *p, uint64 x, int n)
+{
+	int i;
+
+	for (i = n - 1; i >= 0; --i) {
+		p[i] = (unsigned char)x;
+		x >>= 8;
+	}
+}
+
+
+/* open_book() maps the opening book file into memory and initializes the
+   random number generator so we play random book moves. A file that
+   doesn't start with our header isn't used. */
 
 void open_book()
 {
+	FILE *f;
+	long size = 0;
+
 	srand((unsigned int)time(NULL));
-	book_file = fopen("book.txt", "r");
-	if (!book_file)
+	f = fopen(BOOK_FILE, "rb");
+	if (!f) {
+		f = fopen(BOOK_TEXT, "r");
+		if (f) {
+			fclose(f);
+			book_from_text(BOOK_TEXT, BOOK_FILE);
+		}
+		f = fopen(BOOK_FILE, "rb");
+	}
+	if (f) {
+		fseek(f, 0, SEEK_END);
+		size = ftell(f);
+		fclose(f);
+	}
+	book = NULL;
+	book_entries = (int)(size / BOOK_ENTRY_SIZE);
+	if (book_entries) {
+#ifdef _WIN32
+		HANDLE h = CreateFileA(BOOK_FILE, GENERIC_READ, FILE_SHARE_READ, NULL,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+		if (h != INVALID_HANDLE_VALUE) {
+			book_map = CreateFileMappingA(h, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (book_map)
+				book = (unsigned char *)MapViewOfFile(book_map, FILE_MAP_READ,
+						0, 0, 0);
+			CloseHandle(h);
+		}
+#else
+		int fd = open(BOOK_FILE, O_RDONLY);
+
+		if (fd != -1) {
+			book = (unsigned char *)mmap(NULL, size, PROT_READ, MAP_SHARED,
+					fd, 0);
+			if (book == (unsigned char *)MAP_FAILED)
+				book = NULL;
+			close(fd);
+		}
+#endif
+	}
+	if (!book) {
+		book_entries = 0;
 		printf("Opening book missing.\n");
+	}
+	else if (get_be(book, 8) || get_be(book + 12, 4) != BOOK_MAGIC) {
+		close_book();
+		printf("%s isn't one of our books (a Polyglot book's keys wouldn't match ours).\n",
+				BOOK_FILE);
+	}
 }
 
 
-/* close_book() closes the book file. This is called when the program exits. */
+/* close_book() unmaps the book file. This is called when the program exits. */
 
 void close_book()
 {
-	if (book_file)
-		fclose(book_file);
-	book_file = NULL;
+	if (book) {
+#ifdef _WIN32
+		UnmapViewOfFile(book);
+		CloseHandle(book_map);
+#else
+		munmap(book, (size_t)book_entries * BOOK_ENTRY_SIZE);
+#endif
+	}
+	book = NULL;
+	book_entries = 0;
+}
+
+
+/* book_key() returns the key of the current position in the book. It's
+   hash with the castle permissions added, because positions that only
+   differ by them don't have the same book moves. */
+
+HashType book_key()
+{
+	return hash ^ hash_castle[castle];
+}
+
+
+/* poly_move() returns move m in Polyglot's encoding: the to file and
+   rank in bits 0-5, the from file and rank in bits 6-11, and the
+   promotion piece (1 for a knight to 4 for a queen) in bits 12-14.
+   Ranks count from the 1st rank, and castling is written as the king
+   taking its own rook. m has to be a move in the current position. */
+
+int poly_move(move m)
+{
+	int from = MOVE_FROM(m);
+	int to = MOVE_TO(m);
+
+	if (PIECE(from) == KING && (to - from == 2 || from - to == 2))
+		to = (to > from) ? to + 1 : to - 2;
+	return COL(to) | ((7 - ROW(to)) << 3) | (COL(from) << 6)
+			| ((7 - ROW(from)) << 9) | (MOVE_PROMOTE(m) << 12);
 }
 
 
@@ -47,75 +184,179 @@ void close_book()
 
 int book_move()
 {
-	char line[256];
-	char book_line[256];
-	int i, j, m;
-	int move[50];  /* the possible book moves */
-	int count[50];  /* the number of occurrences of each move */
+	HashType key;
+	const unsigned char *e;
+	int lo, hi, mid, i, j;
+	move m[50];  /* the possible book moves */
+	int weight[50];  /* their weights */
 	int moves = 0;
-	int total_count = 0;
+	int total_weight = 0;
 
-	if (!book_file || hply > 25)
+	if (!book || hply > BOOK_PLY)
 		return -1;
 
-	/* line is a string with the current line, e.g., "e2e4 e7e5 g1f3 " */
-	line[0] = '\0';
-	j = 0;
-	for (i = 0; i < hply; ++i)
-		j += sprintf(line + j, "%s ", move_str(hist_dat[i].m.b));
-
-	/* compare line to each line in the opening book */
-	fseek(book_file, 0, SEEK_SET);
-	while (fgets(book_line, 256, book_file)) {
-		if (book_match(line, book_line)) {
+	/* find the first entry of the position */
+	key = book_key();
+	lo = 0;
+	hi = book_entries;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (get_be(book + (size_t)mid * BOOK_ENTRY_SIZE, 8) < key)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-			/* parse the book move that continues the line */
-			m = parse_move(&book_line[strlen(line)]);
-			if (m == -1)
-				continue;
-			m = gen_dat[m].m.u;
-
-			/* add the book move to the move list, or update the move's
-			   count */
-			for (j = 0; j < moves; ++j)
-				if (move[j] == m) {
-					++count[j];
-					break;
-				}
-			if (j == moves) {
-				move[moves] = m;
-				count[moves] = 1;
-				++moves;
-			}
-			++total_count;
-		}
+	/* keep the entries whose moves are legal here */
+	for (i = lo; i < book_entries && moves < 50; ++i) {
+		e = book + (size_t)i * BOOK_ENTRY_SIZE;
+		if (get_be(e, 8) != key)
+			break;
+		for (j = first_move[0]; j < first_move[1]; ++j)
+			if (poly_move(gen_move[j]) == (int)get_be(e + 8, 2))
+				break;
+		if (j == first_move[1] || !get_be(e + 10, 2))
+			continue;
+		if (!makemove(gen_move[j]))
+			continue;
+		takeback();
+		m[moves] = gen_move[j];
+		weight[moves] = (int)get_be(e + 10, 2);
+		total_weight += weight[moves];
+		++moves;
 	}
 
 	/* no book moves? */
 	if (moves == 0)
 		return -1;
 
-	/* Think of total_count as the set of matching book lines.
-	   Randomly pick one of those lines (j) and figure out which
-	   move j "corresponds" to. */
-	j = rand() % total_count;
+	/* Think of total_weight as the set of book games that reached this
+	   position. Randomly pick one of those games (j) and figure out
+	   which move j "corresponds" to. */
+	j = (int)((double)rand() / ((double)RAND_MAX + 1.0) * total_weight);
 	for (i = 0; i < moves; ++i) {
-		j -= count[i];
+		j -= weight[i];
 		if (j < 0)
-			return move[i];
+			return m[i];
 	}
 	return -1;  /* shouldn't get here */
 }
 
 
-/* book_match() returns TRUE if the first part of s2 matches s1. */
+/* compare_book_entries() is the qsort() function that sorts entries by
+   key and move */
 
-BOOL book_match(char *s1, char *s2)
+static int compare_book_entries(const void *a, const void *b)
 {
+	const BookEntry *x = (const BookEntry *)a;
+	const BookEntry *y = (const BookEntry *)b;
+
+	if (x->key != y->key)
+		return (x->key < y->key) ? -1 : 1;
+	return (int)x->move - (int)y->move;
+}
+
+
+/* merge_book() sorts the n entries at e and merges the ones with the
+   same position and move, adding up their weights. It returns the
+   number of entries left. */
+
+int merge_book(BookEntry *e, int n)
+{
+	int i, j, k, w;
+
+	qsort(e, n, sizeof(BookEntry), compare_book_entries);
+	for (i = j = k = 0; i < n; i = j, ++k) {
+		w = 0;
+		for (j = i; j < n && e[j].key == e[i].key && e[j].move == e[i].move; ++j)
+			w += e[j].weight;
+		e[k] = e[i];
+		e[k].weight = (unsigned short)(w > 65535 ? 65535 : w);
+	}
+	return k;
+}
+
+
+/* write_book() merges the n entries at e (see merge_book()) and writes
+   them to the book file s, after the header. It returns the number of
+   entries written, not counting the header, or -1 if s can't be
+   written. */
+
+int write_book(char *s, BookEntry *e, int n)
+{
+	FILE *f;
+	unsigned char buf[BOOK_ENTRY_SIZE];
 	int i;
 
-	for (i = 0; i < (signed int)strlen(s1); ++i)
-		if (s2[i] == '\0' || s2[i] != s1[i])
-			return FALSE;
-	return TRUE;
+	f = fopen(s, "wb");
+	if (!f)
+		return -1;
+	n = merge_book(e, n);
+	memset(buf, 0, sizeof(buf));
+	put_be(buf + 12, BOOK_MAGIC, 4);
+	fwrite(buf, 1, BOOK_ENTRY_SIZE, f);
+	for (i = 0; i < n; ++i) {
+		put_be(buf, e[i].key, 8);
+		put_be(buf + 8, e[i].move, 2);
+		put_be(buf + 10, e[i].weight, 2);
+		put_be(buf + 12, e[i].learn, 4);
+		fwrite(buf, 1, BOOK_ENTRY_SIZE, f);
+	}
+	fclose(f);
+	return n;
+}
+
+
+/* book_from_text() makes the book file out from in, a book in the old
+   text format, where each line is a game's first moves in coordinate
+   notation ("e2e4 e7e5 g1f3 ..."). Each line adds 1 to the weight of
+   the moves it plays in the first BOOK_PLY plies. The board is left in
+   the initial position. */
+
+void book_from_text(char *in, char *out)
+{
+	FILE *f;
+	char line[256];
+	char *s;
+	BookEntry *e = NULL;
+	int n = 0;
+	int size = 0;
+	int m;
+
+	f = fopen(in, "r");
+	if (!f)
+		return;
+	while (fgets(line, 256, f)) {
+		init_board();
+		for (s = strtok(line, " \t\r\n"); s && hply <= BOOK_PLY;
+				s = strtok(NULL, " \t\r\n")) {
+			ply = 0;
+			gen();
+			m = parse_move(s);
+			if (m == -1)
+				break;
+			if (n == size) {
+				size = size ? size * 2 : 4096;
+				e = (BookEntry *)realloc(e, size * sizeof(BookEntry));
+				if (!e) {
+					fclose(f);
+					return;
+				}
+			}
+			e[n].key = book_key();
+			e[n].move = (unsigned short)poly_move(gen_move[m]);
+			e[n].weight = 1;
+			e[n].learn = 0;
+			if (!makemove(gen_move[m]))
+				break;
+			++n;
+		}
+	}
+	fclose(f);
+	init_board();
+	ply = 0;
+	if (n)
+		printf("Opening book: %d entries from %s written to %s.\n",
+				write_book(out, e, n), in, out);
+	free(e);
 }
@@ -8,62 +8,124 @@
 
 #include "defs.h"
 
-HtTyp HT[HT_SIZE];
+CACHE_ALIGN HtBucket HT[HT_BUCKETS];
+THREAD_LOCAL HtBucket *tt_table = HT;  /* the part of HT[] this thread uses: */
+THREAD_LOCAL unsigned int tt_buckets = HT_BUCKETS;  /* all of it, unless the
+                                                      threads of the "suite"
+                                                      command share it */
+THREAD_LOCAL unsigned char tt_age;  /* the age of the current search; see think() */
+THREAD_LOCAL PawnHtTyp PHT[PHT_SIZE];
+#ifdef USE_EVAL_CACHE
+THREAD_LOCAL EvalCacheTyp EC[EC_SIZE];
+#endif
 
 /* the board representation */
-int color[64];  /* LIGHT, DARK, or EMPTY */
-int piece[64];  /* PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, or EMPTY */
-int side;  /* the side to move */
-int xside;  /* the side not to move */
-int castle;  /* a bitfield with the castle permissions. if 1 is set,
+THREAD_LOCAL unsigned char board[64];  /* MAN(color, piece) on each square, or
+                                         EMPTY_SQ; see COLOR() and PIECE() */
+THREAD_LOCAL int side;  /* the side to move */
+THREAD_LOCAL int xside;  /* the side not to move */
+THREAD_LOCAL int castle;  /* a bitfield with the castle permissions. if 1 is set,
                 white can still castle kingside. 2 is white queenside.
 				4 is black kingside. 8 is black queenside. */
-int ep;  /* the en passant square. if white moves e2e4, the en passant
+THREAD_LOCAL int ep;  /* the en passant square. if white moves e2e4, the en passant
             square is set to e3, because that's where a pawn would move
 			in an en passant capture */
-int fifty;  /* the number of moves since a capture or pawn move, used
+THREAD_LOCAL int fifty;  /* the number of moves since a capture or pawn move, used
                to handle the fifty-move-draw rule */
-HashType hash;  /* a (more or less) unique number that corresponds to the
+THREAD_LOCAL HashType hash;  /* a (more or less) unique number that corresponds to the
               position */
-int ply;  /* the number of half-moves (ply) since the
+THREAD_LOCAL HashType pawn_hash;  /* the same thing, for the pawns only */
+THREAD_LOCAL int ply;  /* the number of half-moves (ply) since the
              root of the search tree */
-int hply;  /* h for history; the number of ply since the beginning
+THREAD_LOCAL int hply;  /* h for history; the number of ply since the beginning
               of the game */
 
-/* gen_dat is some memory for move lists that are created by the move
-   generators. The move list for ply n starts at first_move[n] and ends
-   at first_move[n + 1]. */
-gen_t gen_dat[GEN_STACK];
-int first_move[MAX_PLY];
+/* gen_move and gen_score are some memory for move lists that are
+   created by the move generators: the moves, and the scores used to
+   order them. The move list for ply n starts at first_move[n] and ends
+   at first_move[n + 1]. Keeping the scores apart lets sort() scan
+   them with vector instructions. */
+THREAD_LOCAL move gen_move[GEN_STACK];
+THREAD_LOCAL int gen_score[GEN_STACK];
+THREAD_LOCAL int first_move[MAX_PLY];
 
 /* the history heuristic array (used for move ordering) */
-int history[64][64];
+THREAD_LOCAL int history[64][64];
 
 /* we need an array of hist_t's so we can take back the
    moves we make */
-hist_t hist_dat[HIST_STACK];
+THREAD_LOCAL hist_t hist_dat[HIST_STACK];
 
 /* the engine will search for max_time milliseconds or until it finishes
-   searching max_depth ply. */
-long long max_time;
-int max_depth;
+   searching max_depth ply, or if max_nodes isn't 0, until it has searched
+   max_nodes nodes. */
+THREAD_LOCAL long long max_time;
+THREAD_LOCAL int max_depth;
+THREAD_LOCAL unsigned long long max_nodes;
+THREAD_LOCAL unsigned long long check_nodes;  /* when checkup() is next called */
 
 /* the time when the engine starts searching, and when it should stop */
-long long start_time;
-long long stop_time;
-
-unsigned long long  nodes;  /* the number of nodes we've searched */
+THREAD_LOCAL long long start_time;
+THREAD_LOCAL long long stop_ns;  /* in get_ns() time */
+
+/* the best move after each iteration of the last search, and when the
+   iteration finished, in milliseconds from start_time */
+THREAD_LOCAL move iter_move[MAX_PLY];
+THREAD_LOCAL long long iter_ms[MAX_PLY];
+THREAD_LOCAL int iterations;  /* the iterations finished */
+
+THREAD_LOCAL unsigned long long  nodes;  /* the number of nodes we've searched */
+THREAD_LOCAL unsigned long long  evals;  /* the number of calls to eval() */
+THREAD_LOCAL unsigned long long  pawn_probes;  /* pawn hash table lookups by eval() */
+THREAD_LOCAL unsigned long long  pawn_hits;  /* ...and how many of them found the entry */
+THREAD_LOCAL unsigned long long  tt_probes;  /* hash table lookups by search() and quiesce() */
+THREAD_LOCAL unsigned long long  tt_hits;  /* ...and how many of them found the position */
+THREAD_LOCAL unsigned long long  tt_bad_moves;  /* hits whose move couldn't be played */
+THREAD_LOCAL unsigned long long  tt_collisions;  /* HASH_STATS: hits for another position */
+THREAD_LOCAL unsigned long long  q_nodes;  /* SEARCH_STATS: the nodes searched by quiesce() */
+THREAD_LOCAL unsigned long long  tt_cutoffs;  /* SEARCH_STATS: nodes the hash table answered */
+THREAD_LOCAL unsigned long long  tt_stores;  /* SEARCH_STATS: results written by putTT() */
+THREAD_LOCAL unsigned long long  tt_overwrites;  /* SEARCH_STATS: entries of other positions replaced */
+THREAD_LOCAL unsigned long long  beta_cutoffs;  /* SEARCH_STATS: search() nodes that failed high */
+THREAD_LOCAL unsigned long long  first_cutoffs;  /* SEARCH_STATS: ...on the first move searched */
+THREAD_LOCAL int sel_depth;  /* SEARCH_STATS: the deepest ply reached */
+THREAD_LOCAL BOOL trace_on;  /* TRACE: is this thread writing the trace? */
+THREAD_LOCAL unsigned char trace_cut[MAX_PLY];  /* TRACE: the moves each ply searched before a cutoff */
+THREAD_LOCAL unsigned long long  eval_hits;  /* eval() calls answered by the eval cache */
+THREAD_LOCAL unsigned long long  tt_evals;  /* static evals quiesce() took from the hash table */
+THREAD_LOCAL unsigned long long  lazy_tries;  /* calls to lazy_eval() */
+THREAD_LOCAL unsigned long long  lazy_exits;  /* ...that returned the material bound */
+THREAD_LOCAL unsigned long long  lazy_wrong;  /* LAZY_EVAL_STATS: exits eval() disagrees with */
+THREAD_LOCAL long long  lazy_error;  /* LAZY_EVAL_STATS: sum of |eval() - bound| on exits */
+
+/* nnue_loaded is TRUE if a network was read; use_nnue selects it
+   instead of the handcrafted evaluation */
+BOOL nnue_loaded = FALSE;
+BOOL use_nnue = FALSE;
+
+/* tuning is TRUE while tune() runs quiesce() in several threads. They
+   can't share the hash table, and the lazy eval margin would hide the
+   terms being tuned, so both are bypassed. */
+BOOL tuning = FALSE;
+
+/* deterministic makes every search repeatable: think() doesn't use the
+   book and empties the hash tables first, and run_threads() runs one
+   thread at a time */
+BOOL deterministic = FALSE;
 
 /* a "triangular" PV array; for a good explanation of why a triangular
    array is needed, see "How Computers Play Chess" by Levy and Newborn. */
-move pv[MAX_PLY][MAX_PLY];
-int pv_length[MAX_PLY];
-BOOL follow_pv;
-
-/* random numbers used to compute hash; see set_hash() in board.c */
-HashType hash_piece[2][6][64];  /* indexed by piece [color][type][square] */
-HashType hash_side;
-HashType hash_ep[64];
+THREAD_LOCAL move pv[MAX_PLY][MAX_PLY];
+THREAD_LOCAL int pv_length[MAX_PLY];
+THREAD_LOCAL BOOL follow_pv;
+
+/* the material and piece/square sums of each side. Like hash, they're
+   updated by makemove() instead of being recomputed by eval(); see
+   set_material() in eval.c */
+THREAD_LOCAL int piece_mat[2];  /* the value of a side's pieces */
+THREAD_LOCAL int pawn_mat[2];  /* the value of a side's pawns */
+THREAD_LOCAL int pcsq_mat[2];  /* the sum of the piece/square values of a side's men */
+int pcsq[2][6][64];  /* piece/square values indexed by [color][type][square] */
 
 /* Now we have the mailbox array, so called because it looks like a
    mailbox, at least according to Bob Hyatt. This is useful when we
@@ -128,6 +190,13 @@ int offset[6][8] = {
 };
 
 
+/* pawn_push[] is the direction each side's pawns move in */
+
+int pawn_push[2] = {
+	-8, 8
+};
+
+
 /* This is the castle_mask array. We can use it to determine
    the castling permissions after a move. What we do is
    logical-AND the castle bits with the castle_mask bits for
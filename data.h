@@ -10,41 +10,120 @@
    of the source files so they can use the data.c variables */
 #include "defs.h"
 
-extern int color[64];
-extern int piece[64];
-extern int side;
-extern int xside;
-extern int castle;
-extern int ep;
-extern int fifty;
-extern int ply;
-extern int hply;
-extern gen_t gen_dat[GEN_STACK];
-extern int first_move[MAX_PLY];
-extern int history[64][64];
-extern hist_t hist_dat[HIST_STACK];
-extern long long max_time;
-extern int max_depth;
-extern long long start_time;
-extern long long stop_time;
-extern unsigned long long nodes;
-extern move pv[MAX_PLY][MAX_PLY];
-extern int pv_length[MAX_PLY];
-extern BOOL follow_pv;
-extern HashType  hash;
-extern HashType hash_piece[2][6][64];
-extern HashType hash_side;
-extern HashType hash_ep[64];
+extern THREAD_LOCAL unsigned char board[64];
+#define COLOR(sq)		(board[sq] >> 3)  /* LIGHT, DARK, or EMPTY */
+#define PIECE(sq)		(board[sq] & 7)  /* PAWN, ..., KING, or EMPTY */
+extern THREAD_LOCAL int side;
+extern THREAD_LOCAL int xside;
+extern THREAD_LOCAL int castle;
+extern THREAD_LOCAL int ep;
+extern THREAD_LOCAL int fifty;
+extern THREAD_LOCAL int ply;
+extern THREAD_LOCAL int hply;
+extern THREAD_LOCAL move gen_move[GEN_STACK];
+extern THREAD_LOCAL int gen_score[GEN_STACK];
+extern THREAD_LOCAL int first_move[MAX_PLY];
+extern THREAD_LOCAL int history[64][64];
+extern THREAD_LOCAL hist_t hist_dat[HIST_STACK];
+extern THREAD_LOCAL long long max_time;
+extern THREAD_LOCAL int max_depth;
+extern THREAD_LOCAL unsigned long long max_nodes;
+extern THREAD_LOCAL unsigned long long check_nodes;
+extern THREAD_LOCAL long long start_time;
+extern THREAD_LOCAL long long stop_ns;
+extern THREAD_LOCAL move iter_move[MAX_PLY];
+extern THREAD_LOCAL long long iter_ms[MAX_PLY];
+extern THREAD_LOCAL int iterations;
+extern THREAD_LOCAL unsigned long long nodes;
+extern THREAD_LOCAL unsigned long long evals;
+extern THREAD_LOCAL unsigned long long pawn_probes;
+extern THREAD_LOCAL unsigned long long pawn_hits;
+extern THREAD_LOCAL unsigned long long tt_probes;
+extern THREAD_LOCAL unsigned long long tt_hits;
+extern THREAD_LOCAL unsigned long long tt_bad_moves;
+extern THREAD_LOCAL unsigned long long tt_collisions;
+extern THREAD_LOCAL unsigned long long q_nodes;
+extern THREAD_LOCAL unsigned long long tt_cutoffs;
+extern THREAD_LOCAL unsigned long long tt_stores;
+extern THREAD_LOCAL unsigned long long tt_overwrites;
+extern THREAD_LOCAL unsigned long long beta_cutoffs;
+extern THREAD_LOCAL unsigned long long first_cutoffs;
+extern THREAD_LOCAL int sel_depth;
+extern THREAD_LOCAL BOOL trace_on;
+extern THREAD_LOCAL unsigned char trace_cut[MAX_PLY];
+extern THREAD_LOCAL unsigned long long eval_hits;
+extern THREAD_LOCAL unsigned long long tt_evals;
+extern THREAD_LOCAL unsigned long long lazy_tries;
+extern THREAD_LOCAL unsigned long long lazy_exits;
+extern THREAD_LOCAL unsigned long long lazy_wrong;
+extern THREAD_LOCAL long long lazy_error;
+extern BOOL nnue_loaded;
+extern BOOL use_nnue;
+extern BOOL tuning;
+extern BOOL deterministic;
+extern THREAD_LOCAL move pv[MAX_PLY][MAX_PLY];
+extern THREAD_LOCAL int pv_length[MAX_PLY];
+extern THREAD_LOCAL BOOL follow_pv;
+extern THREAD_LOCAL HashType  hash;
+extern THREAD_LOCAL HashType  pawn_hash;
+extern THREAD_LOCAL int piece_mat[2];
+extern THREAD_LOCAL int pawn_mat[2];
+extern THREAD_LOCAL int pcsq_mat[2];
+extern int pcsq[2][6][64];
 extern int mailbox[120];
 extern int mailbox64[64];
 extern BOOL slide[6];
 extern int offsets[6];
 extern int offset[6][8];
+extern int pawn_push[2];
 extern int castle_mask[64];
 extern char piece_char[6];
 extern int init_color[64];
 extern int init_piece[64];
-extern HtTyp HT[HT_SIZE];
+extern HtBucket HT[HT_BUCKETS];
+extern THREAD_LOCAL HtBucket *tt_table;
+extern THREAD_LOCAL unsigned int tt_buckets;
+extern THREAD_LOCAL unsigned char tt_age;
+extern THREAD_LOCAL PawnHtTyp PHT[PHT_SIZE];
+#ifdef USE_EVAL_CACHE
+extern THREAD_LOCAL EvalCacheTyp EC[EC_SIZE];
+#endif
+
+/* eval.c */
+extern int doubled_pawn_penalty;
+extern int isolated_pawn_penalty;
+extern int backwards_pawn_penalty;
+extern int passed_pawn_bonus;
+extern int candidate_pawn_bonus;
+extern int rook_semi_open_file_bonus;
+extern int rook_open_file_bonus;
+extern int rook_on_seventh_bonus;
+extern int shield_pawn[3];
+extern int shield_storm[3];
+extern int shield_open_file;
+extern int mobility_bonus[6];
+extern int mobility_base[6];
+extern int king_attack_bonus[6];
+extern int hanging_piece_penalty;
+extern int piece_value[6];
+extern int pawn_pcsq[64];
+extern int knight_pcsq[64];
+extern int bishop_pcsq[64];
+extern int king_pcsq[64];
+extern int king_endgame_pcsq[64];
+
+/* tables.c */
+extern const HashType hash_piece[2][6][64];
+extern const HashType hash_side;
+extern const HashType hash_ep[64];
+extern const HashType hash_castle[16];
+extern const uint64 front_mask[2][64];
+extern const uint64 passed_mask[2][64];
+extern const uint64 support_mask[2][64];
+extern const uint64 isolated_mask[64];
+extern const uint64 knight_att[64];
+extern const uint64 king_att[64];
+extern const uint64 ray[8][64];
 
 #ifdef _DEBUG
 	#define ASSERT(a) if (!(a)) {int n=0; n/=n;};
@@ -11,6 +11,16 @@
 #define TRUE			1
 #define FALSE			0
 
+/* The board, the search state and the eval caches are per thread, so that
+   tune.c can run several searches at once. The hash table is shared. */
+#ifdef _MSC_VER
+#define THREAD_LOCAL	__declspec(thread)
+#else
+#define THREAD_LOCAL	__thread
+#endif
+
+#define MAX_THREADS		64
+
 #define GEN_STACK		1120
 #define MAX_PLY			32
 #define HIST_STACK		400
@@ -27,6 +37,19 @@
 
 #define EMPTY			6
 
+/* A square of the board holds its man's color and type in one byte, so
+   the whole board fits in 64 bytes. An empty square is EMPTY for both,
+   so COLOR() and PIECE() (see data.h) work just like the old color[]
+   and piece[] arrays. */
+#define MAN(c, p)		((c) * 8 + (p))
+#define EMPTY_SQ		MAN(EMPTY, EMPTY)
+
+/* bitboards of the squares holding men of side s, any man, or a given
+   man, from SIMD compares of the whole board (see board_mask()) */
+#define SIDE_MASK(s)	board_mask(0xF8, (s) << 3)
+#define OCCUPIED_MASK()	(~board_mask(0xFF, EMPTY_SQ))
+#define MAN_MASK(c, p)	board_mask(0xFF, MAN(c, p))
+
 /* useful squares */
 #define A1				56
 #define B1				57
@@ -45,56 +68,78 @@
 #define G8				6
 #define H8				7
 
-#define ROW(x)			(x >> 3)
-#define COL(x)			(x & 7)
+#define ROW(x)			((x) >> 3)
+#define COL(x)			((x) & 7)
+
 
+/* This is the basic description of a move, packed into 16 bits:
+   the from square, the to square, and the piece to promote the
+   pawn to, if the move is a pawn promotion (0 otherwise). Two
+   moves can be compared with ==, and 0 (a8a8) is never a real
+   move, so it's used for "no move."
 
-/* This is the basic description of a move. promote is what
-   piece to promote the pawn to, if the move is a pawn
-   promotion. bits is a bitfield that describes the move,
-   with the following bits:
+   makemove() also needs to know what kind of move it is. That's
+   a bitfield with the following bits, which move_bits() in board.c
+   works out from the board before the move is made:
 
    1	capture
    2	castle
    4	en passant capture
    8	pushing a pawn 2 squares
    16	pawn move
-   32	promote
+   32	promote */
 
-   It's union'ed with an integer so two moves can easily
-   be compared with each other. */
+typedef unsigned short move;
 
-typedef struct {
-	char from;
-	char to;
-	char promote;
-	char bits;
-} move_bytes;
-
-typedef union {
-	move_bytes b;
-	int u;
-} move;
-
-/* an element of the move stack. it's just a move with a
-   score, so it can be sorted by the search functions. */
-typedef struct {
-	move m;
-	int score;
-} gen_t;
+#define MOVE(from, to, promote)	((move)((from) | ((to) << 6) | ((promote) << 12)))
+#define MOVE_FROM(m)	((m) & 63)
+#define MOVE_TO(m)		(((m) >> 6) & 63)
+#define MOVE_PROMOTE(m)	((m) >> 12)
+
+typedef unsigned long long uint64;
+typedef uint64 HashType; // Type pour les hash, 64 bits partout (unsigned long n'en a que 32 sous Windows)
 
-typedef unsigned long HashType; // Type pour les hash
+/* bitboard helpers: the number of bits set, and the lowest and highest ones */
+#ifdef __GNUC__
+#define POPCOUNT(b)		__builtin_popcountll(b)
+#define LSB(b)			__builtin_ctzll(b)
+#define MSB(b)			(63 - __builtin_clzll(b))
+#else
+#define POPCOUNT(b)		popcount(b)
+#define LSB(b)			lsb(b)
+#define MSB(b)			msb(b)
+#endif
 /* an element of the history stack, with the information
    necessary to take a move back. */
 typedef struct {
 	move m;
+	int bits;  /* move_bits() of m */
 	int capture;
 	int castle;
 	int ep;
 	int fifty;
 	HashType hash;
+	HashType pawn_hash;
+	int piece_mat[2];
+	int pawn_mat[2];
+	int pcsq_mat[2];
 } hist_t;
 
+// Functions that take the side as a parameter and are meant to be
+// compiled once per side (see gen_side() in board.c)
+#ifdef _MSC_VER
+#define FORCEINLINE __forceinline
+#else
+#define FORCEINLINE inline __attribute__((always_inline))
+#endif
+
+// Data that should start on a cache line
+#ifdef _MSC_VER
+#define CACHE_ALIGN __declspec(align(64))
+#else
+#define CACHE_ALIGN __attribute__((aligned(64)))
+#endif
+
 // Assertions
 #ifdef _DEBUG
 #define ASSERT(a) if (!(a)) {int n=0; n/=n;};
@@ -102,12 +147,89 @@ typedef struct {
 #define ASSERT(a) ;
 #endif
 
+// The hash table is made of 64-byte buckets, each holding HT_WAYS entries
+// and the top 32 bits of their keys; the bucket is picked by the rest.
+// HASH_STATS also keeps the full keys, to count the entries that are
+// found for the wrong position.
 #define USE_HASH
-#define HT_SIZE 10000000
+#define HT_BUCKETS 2500000
+#define HT_WAYS 5
+#define HT_KEY(h) ((unsigned int)((h) >> 32))
+//#define HASH_STATS
+
+// Search statistics: SEARCH_STATS counts quiescence nodes, hash table
+// cutoffs, stores and overwrites, beta cutoffs and how many came from the
+// first move, and the selective depth, and think() prints them after each
+// iteration. Without it, STATS() compiles them out.
+//#define SEARCH_STATS
+#ifdef SEARCH_STATS
+#define STATS(x) x
+#else
+#define STATS(x)
+#endif
+
+// Profiling: PROFILE times the calls search() and quiesce() make to the
+// move generator, makemove() and takeback(), the evaluation, getTT(),
+// and sort(), and counts the cycles, cache misses, and branch
+// misses they take where the processor's counters are available (see
+// perf.c). think() prints a table of them when it's done. The profiled
+// search is much slower, so only the shares mean anything.
+//#define PROFILE
+#ifdef PROFILE
+#define PROFILE_START() prof_start()
+#define PROFILE_STOP(s) prof_stop(s)
+#else
+#define PROFILE_START()
+#define PROFILE_STOP(s)
+#endif
+
+// the subsystems PROFILE times
+#define PROF_GEN 0
+#define PROF_MAKE 1
+#define PROF_EVAL 2
+#define PROF_TT 3
+#define PROF_SORT 4
+#define PROF_SUBSYSTEMS 5
+
+// checkup() reads the clock about every POLL_NS nanoseconds: from the
+// search speed, it picks the nodes until its next call, between POLL_MIN
+// and POLL_MAX
+#define POLL_NS 250000
+#define POLL_MIN 64
+#define POLL_MAX 65536
+
+// Tracing: TRACE adds the "trace" command, which has search() and
+// quiesce() write a record of every node to a ring of TRACE_RECORDS (a
+// power of 2) in a file mapped into memory; "tracestat" summarizes the
+// file. See trace.c. Without it, TRACE_CUT() compiles out.
+//#define TRACE
+#define TRACE_FILE "trace.bin"
+#define TRACE_RECORDS (1 << 22)
+#define TRACE_NONE 255  // the cut of a node no move failed high at
+#define TRACE_QUIESCE 1  // a record's flag: quiesce() searched the node
+#ifdef TRACE
+#define TRACE_CUT(n) (trace_cut[ply] = (unsigned char)(n))
+#else
+#define TRACE_CUT(n)
+#endif
+
+// the events perf_open() can count
+#define COUNT_CYCLES 0
+#define COUNT_INSTRUCTIONS 1
+#define COUNT_CACHE_MISSES 2
+#define COUNT_BRANCH_MISSES 3
+#define MAX_COUNTERS 4
 
 // DM2 - optim hash de Zobrist
 #define USE_FAST_HASH
 
+// Internal iterative deepening: when the hash table has no move for a
+// node at least IID_DEPTH deep, a search reduced by IID_REDUCTION is run
+// first to find one
+#define USE_IID
+#define IID_DEPTH 4
+#define IID_REDUCTION 2
+
 #define PLUS_INFINI (10000)
 #define MOINS_INFINI (-10000)
 
@@ -130,17 +252,102 @@ typedef struct {
 #define FLAG_VALID				1
 #define FLAG_L_BOUND			2 // Eval is the lower bound, real eval should be higher
 #define FLAG_U_BOUND			4
+#define FLAG_EVAL				8 // The eval field holds the static evaluation
+#define FLAG_MASK				15 // The rest of flag is the age of the entry
+#define AGE_STEP				16
 
 
 typedef struct
 {
-	HashType hash;
 	move	move;     // est utilise pour le tri des coups (pas indispensable dans 1 premier temps)
 	short   score;
-	unsigned char flag;     // indique si le score est vrai, inferieur ou superieur
+	short   eval;     // evaluation statique de la position, si FLAG_EVAL
 	unsigned char depth;    // le nombre de coup avant la quiescence.
+	unsigned char flag;     // indique si le score est vrai, inferieur ou superieur, et l'age
 } HtTyp;
 
+typedef struct
+{
+	unsigned int key[HT_WAYS];  // HT_KEY() of each entry's position
+	unsigned int unused;  // pads the bucket to 64 bytes
+	HtTyp entry[HT_WAYS];
+} HtBucket;
+
+// Lazy evaluation: quiesce() skips the positional terms of eval() when
+// material and piece/square values are LAZY_MARGIN outside the window.
+// LAZY_EVAL_STATS computes the full eval anyway to measure the error.
+#define USE_LAZY_EVAL
+#define LAZY_MARGIN 200
+//#define LAZY_EVAL_STATS
+
+// Eval cache: a small table of eval() results indexed by hash, so that
+// positions reached again through transpositions aren't evaluated twice.
+// Off, since putTTEval() already keeps every eval in the hash table and
+// the cache no longer gets any hits (bench: 0 of 683851 evals).
+//#define USE_EVAL_CACHE
+#define EC_SIZE 32768 // must be a power of 2
+
+typedef struct
+{
+	HashType hash;
+	int     score;    // eval() of the position, relative to the side to move
+} EvalCacheTyp;
+
+// Pawn hash table: the pawn structure terms only depend on where the pawns
+// are, so they're cached by pawn_hash (the Zobrist key of the pawns alone)
+#define USE_PAWN_HASH
+#define PHT_SIZE 16384 // must be a power of 2
+
+typedef struct
+{
+	HashType hash;             // pawn_hash of the position
+	uint64  passed[2];         // bit sq is set if the pawn on sq is passed
+	short   score[2];          // pawn structure score of each side
+	short   shield[2][4];      // king shield of each side, by king_zone[]
+	unsigned char rank[2][10]; // pawn_rank[][]; see eval.c
+} PawnHtTyp;
+
+// NNUE: optional neural network evaluation, used instead of the handcrafted
+// one when NNUE_FILE is found at startup. The layer sizes are those of the
+// HalfKP 2x256-32-32-1 networks; see nnue.c
+#define USE_NNUE
+#define NNUE_FILE "nn.nnue"
+#define NNUE_INPUTS (64 * 641)
+#define NNUE_HALF 256
+#define NNUE_L1 32
+#define NNUE_L2 32
+
+// Tuning: the "tune" command writes the evaluation terms it finds here
+#define TUNE_FILE "tuned.txt"
+
+// Opening book: a file of Polyglot-style entries sorted by key, with our
+// own keys, made from BOOK_TEXT when it's missing; see book.c. The book is
+// used for the first BOOK_PLY plies of the game. BOOK_MAGIC ("TSCP") marks
+// the header entry our books start with.
+#define BOOK_FILE "book.bin"
+#define BOOK_TEXT "book.txt"
+#define BOOK_PLY 25
+#define BOOK_MAGIC 0x54534350
+
+typedef struct
+{
+	HashType key;           // book_key() of the position
+	unsigned short move;    // poly_move() of the move
+	unsigned short weight;  // how often the move was played
+	unsigned int learn;     // unused, 0
+} BookEntry;
+
+// The "suite" command searches its positions to SUITE_DEPTH with SUITE_MB
+// of hash per thread unless told otherwise, and writes SUITE_FILE
+#define SUITE_DEPTH 5
+#define SUITE_MB 16
+#define SUITE_FILE "suite.json"
+
+// The "epd" command searches each position for EPD_TIME milliseconds
+// unless told otherwise, and keeps up to EPD_MOVES bm and am moves for it
+#define EPD_TIME 5000
+#define EPD_MOVES 8
+
 typedef struct
 {
 	HtTyp hash;
@@ -0,0 +1,270 @@
+/*
+ *	EPD.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Running a test suite of EPD positions
+ */
+
+
+/* epd() is the "epd" command. It searches each position of an EPD file,
+   like the Win at Chess suite, and checks the move it finds against the
+   position's "bm" (best move) and "am" (avoid move) operations: a
+   position is solved if the move is one of its best moves and none of
+   its moves to avoid. The moves may be in standard algebraic notation,
+   which is what EPD files use, or in coordinate notation.
+
+   The positions are split between one thread per processor, each with
+   its own board and its own part of the hash table, which is emptied
+   before every position so the results don't depend on the order the
+   positions were searched in. A position is searched for a time or to a
+   depth, and its solution time is when the iteration finished after
+   which the best move stayed right, or the end of the search if it only
+   became right in the last, unfinished one. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+#define EPD_LINE	512
+
+/* a position of the file, and what searching it gave */
+typedef struct {
+	char line[EPD_LINE];
+	char id[32];  /* its "id" operation */
+	move bm[EPD_MOVES];
+	move am[EPD_MOVES];
+	int bms;
+	int ams;
+	BOOL ok;  /* could the position and its operations be read? */
+	move best;  /* the move the search found */
+	BOOL solved;
+	long long solve_ms;  /* when it was found for good */
+	long long ms;
+	unsigned long long nodes;
+} epd_pos_t;
+
+/* what the threads are told to do */
+typedef struct {
+	int threads;
+	long long ms;  /* the time for each position, or 0 */
+	int depth;  /* ...or the depth */
+	unsigned int buckets;  /* the size of each thread's slice of HT[] */
+} epd_t;
+
+static epd_pos_t *epd_pos;
+static int epd_count;
+
+
+/* parse_ops() reads the operations of position p, which are at s, after
+   the position has been set up and its moves generated. It returns FALSE
+   if there's a bm or am move that isn't legal or can't be read, or if
+   there's neither. */
+
+static BOOL parse_ops(epd_pos_t *p, char *s)
+{
+	char op[EPD_LINE], name[16], arg[32];
+	char *a, *end;
+	int n, m;
+
+	while (*s) {
+
+		/* the next operation, up to its ';' */
+		end = strchr(s, ';');
+		n = end ? (int)(end - s) : (int)strlen(s);
+		memcpy(op, s, n);
+		op[n] = '\0';
+		s += end ? n + 1 : n;
+		if (sscanf(op, "%15s%n", name, &n) != 1)
+			continue;
+		a = op + n;
+
+		if (!strcmp(name, "id")) {
+			while (*a == ' ' || *a == '"')
+				++a;
+			for (n = 0; a[n] && a[n] != '"' && n < 31; ++n)
+				p->id[n] = a[n];
+			p->id[n] = '\0';
+		}
+		else if (!strcmp(name, "bm") || !strcmp(name, "am"))
+			while (sscanf(a, "%31s%n", arg, &n) == 1) {
+				a += n;
+				m = parse_san(arg);
+				if (m == -1)
+					m = parse_move(arg);
+				if (m == -1)
+					return FALSE;
+				if (name[0] == 'b' && p->bms < EPD_MOVES)
+					p->bm[p->bms++] = gen_move[m];
+				else if (name[0] == 'a' && p->ams < EPD_MOVES)
+					p->am[p->ams++] = gen_move[m];
+			}
+	}
+	return p->bms || p->ams;
+}
+
+
+/* correct() returns TRUE if m solves position p */
+
+static BOOL correct(epd_pos_t *p, move m)
+{
+	int i;
+
+	for (i = 0; i < p->ams; ++i)
+		if (p->am[i] == m)
+			return FALSE;
+	if (!p->bms)
+		return m != 0;
+	for (i = 0; i < p->bms; ++i)
+		if (p->bm[i] == m)
+			return TRUE;
+	return FALSE;
+}
+
+
+/* epd_slice() is the work of thread i in epd(): every threads-th
+   position, starting with the i-th */
+
+static void epd_slice(int i, void *arg)
+{
+	epd_t *e = (epd_t *)arg;
+	epd_pos_t *p;
+	char *rest;
+	int n, k;
+
+	tt_table = HT + (size_t)i * e->buckets;
+	tt_buckets = e->buckets;
+	for (n = i; n < epd_count; n += e->threads) {
+		p = &epd_pos[n];
+		rest = set_fen(p->line);
+		if (!rest)
+			continue;
+		gen();
+		if (!parse_ops(p, rest))
+			continue;
+		p->ok = TRUE;
+		initHT();
+		initPHT();
+		initEC();
+		if (e->ms) {
+			max_time = e->ms;
+			max_depth = 32;
+		}
+		else {
+			max_time = 1 << 25;
+			max_depth = e->depth;
+		}
+		max_nodes = 0;
+		think(0);
+		p->ms = get_ms() - start_time;
+		p->nodes = nodes;
+		p->best = pv[0][0];
+		p->solved = correct(p, p->best);
+
+		/* it was found when the iterations started agreeing on it */
+		p->solve_ms = p->ms;
+		if (p->solved)
+			for (k = iterations - 1; k >= 0 && correct(p, iter_move[k]); --k)
+				p->solve_ms = iter_ms[k];
+	}
+}
+
+
+/* epd() is the "epd" command: it runs the positions of the EPD file named
+   file, searching each one for ms milliseconds, or if ms is 0, to depth
+   ply */
+
+void epd(char *file, long long ms, int depth)
+{
+	FILE *f;
+	epd_t e;
+	epd_pos_t *p;
+	char line[EPD_LINE];
+	unsigned long long total = 0;
+	int i, size = 0, solved = 0, bad = 0;
+	long long t;
+
+	f = fopen(file, "r");
+	if (!f) {
+		printf("Can't open %s.\n", file);
+		return;
+	}
+	epd_count = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (strspn(line, " \t\r\n") == strlen(line))
+			continue;
+		if (epd_count == size) {
+			size = size ? size * 2 : 256;
+			p = (epd_pos_t *)realloc(epd_pos, size * sizeof(epd_pos_t));
+			if (!p) {
+				printf("Out of memory.\n");
+				break;
+			}
+			epd_pos = p;
+		}
+		p = &epd_pos[epd_count++];
+		memset(p, 0, sizeof(epd_pos_t));
+		strcpy(p->line, line);
+		p->line[strcspn(p->line, "\r\n")] = '\0';
+	}
+	fclose(f);
+	if (!epd_count) {
+		printf("No positions in %s.\n", file);
+		return;
+	}
+
+	e.threads = cpu_count();
+	if (e.threads > epd_count)
+		e.threads = epd_count;
+	e.ms = ms;
+	e.depth = depth;
+	e.buckets = HT_BUCKETS / e.threads;
+	if (ms)
+		printf("%d positions, %.1f s each, %d threads\n", epd_count, ms / 1000.0, e.threads);
+	else
+		printf("%d positions, %d ply each, %d threads\n", epd_count, depth, e.threads);
+
+	close_book();  /* book moves would stop think() from searching */
+	t = get_ms();
+	run_threads(e.threads, epd_slice, &e);
+	t = get_ms() - t;
+
+	printf("\n");
+	printf("  #  id                move    result    solved at      nodes\n");
+	for (i = 0; i < epd_count; ++i) {
+		p = &epd_pos[i];
+		if (!p->ok) {
+			++bad;
+			printf("%3d  %-16s  (the position or its bm/am moves couldn't be read)\n",
+					i + 1, p->id);
+			continue;
+		}
+		total += p->nodes;
+		if (p->solved) {
+			++solved;
+			printf("%3d  %-16s  %-6s  solved  %8lld ms %10llu\n", i + 1, p->id,
+					move_str(p->best), p->solve_ms, p->nodes);
+		}
+		else
+			printf("%3d  %-16s  %-6s  failed  %11s %10llu\n", i + 1, p->id,
+					move_str(p->best), "-", p->nodes);
+	}
+	printf("\n");
+	printf("Solved: %d of %d (%.1f%%)", solved, epd_count - bad,
+			epd_count > bad ? 100.0 * solved / (epd_count - bad) : 0.0);
+	if (bad)
+		printf(", %d couldn't be read", bad);
+	printf("\n");
+	printf("Time: %lld ms\n", t);
+	printf("Nodes: %llu\n", total);
+	printf("Nodes per second: %.0f (all threads)\n", t ? 1000.0 * (double)total / (double)t : 0.0);
+
+	free(epd_pos);
+	epd_pos = NULL;
+	epd_count = 0;
+	open_book();
+}
@@ -12,13 +12,44 @@
 #include "protos.h"
 
 
-#define DOUBLED_PAWN_PENALTY		10
-#define ISOLATED_PAWN_PENALTY		20
-#define BACKWARDS_PAWN_PENALTY		8
-#define PASSED_PAWN_BONUS			20
-#define ROOK_SEMI_OPEN_FILE_BONUS	10
-#define ROOK_OPEN_FILE_BONUS		15
-#define ROOK_ON_SEVENTH_BONUS		20
+/* The evaluation terms are variables rather than constants so that
+   tune() can adjust them. */
+int doubled_pawn_penalty = 10;
+int isolated_pawn_penalty = 20;
+int backwards_pawn_penalty = 8;
+int passed_pawn_bonus = 20;
+int candidate_pawn_bonus = 5;
+int rook_semi_open_file_bonus = 10;
+int rook_open_file_bonus = 15;
+int rook_on_seventh_bonus = 20;
+
+/* the king shield penalties (see eval_lkp()): for a pawn in front of the
+   king that moved one square, more than one square, or is gone; for an
+   enemy pawn that is gone, on the 3rd rank, or on the 4th; and for each
+   open file next to a king that isn't castled */
+int shield_pawn[3] = {
+	10, 20, 25
+};
+int shield_storm[3] = {
+	15, 10, 5
+};
+int shield_open_file = 10;
+
+/* the attack map terms (see eval_attacks()): for each piece type, a
+   bonus for each square it can move to beyond mobility_base, and a bonus
+   for each square next to the enemy king it attacks (counted when at
+   least two pieces attack the king); and a penalty for each piece that
+   is attacked and not defended, or attacked by a pawn */
+int mobility_bonus[6] = {
+	0, 4, 4, 2, 1, 0
+};
+int mobility_base[6] = {
+	0, 4, 6, 7, 13, 0
+};
+int king_attack_bonus[6] = {
+	0, 3, 3, 4, 6, 0
+};
+int hanging_piece_penalty = 15;
 
 
 /* the values of the pieces */
@@ -104,72 +135,387 @@ int flip[64] = {
    y - 1. There are "buffer files" on the left and right to avoid special-case
    logic later. If there's no pawn on a rank, we pretend the pawn is
    impossibly far advanced (0 for LIGHT and 7 for DARK). This makes it easy to
-   test for pawns on a rank and it simplifies some pawn evaluation code. */
-int pawn_rank[2][10];
+   test for pawns on a rank and it simplifies some pawn evaluation code.
+   It points into the pawn hash entry of the position being evaluated
+   (pawns), which also holds the other terms that only depend on the pawns. */
+THREAD_LOCAL unsigned char (*pawn_rank)[10];
+THREAD_LOCAL PawnHtTyp *pawns;
+
+/* king_zone[] maps the king's file to the pawn shield it uses in
+   PawnHtTyp.shield: castled queenside, on the d file, on the e file,
+   or castled kingside */
+int king_zone[8] = {
+	0, 0, 0, 1, 2, 3, 3, 3
+};
 
-int piece_mat[2];  /* the value of a side's pieces */
-int pawn_mat[2];  /* the value of a side's pawns */
+/* The pawn structure is evaluated with bitboards: bit sq of pawn_bb[c]
+   is set if a pawn of color c is on square sq. For a pawn of color c
+   on sq, seen from c's side of the board:
+   front_mask[c][sq] is the squares in front of it on its file,
+   passed_mask[c][sq] adds the squares in front of it on the adjacent
+   files; the pawn is passed if no enemy pawn is there,
+   support_mask[c][sq] is the squares beside and behind it on the
+   adjacent files; the pawn is backwards if no friendly pawn is there,
+   isolated_mask[sq] is the adjacent files.
+   The masks are constants in tables.c. */
+THREAD_LOCAL uint64 pawn_bb[2];
+
+/* knight_att[sq] and king_att[sq] are the squares a knight or king on
+   sq attacks. ray[d][sq] is the squares from sq to the edge of the board
+   in direction d; the first four directions go to higher squares, so
+   the first piece on them is the LSB(), and the others to lower
+   squares.
+   These tables are constants in tables.c. */
+
+#define FILE_A	0x0101010101010101ULL
+#define FILE_H	0x8080808080808080ULL
+
+/* init_eval() fills in pcsq[][][] from the tables above, so that
+   makemove() can update the piece/square sums with a single lookup,
+   the same way it updates the hash with hash_piece[][][]. Rooks and
+   queens have no piece/square table, and the king's depends on the
+   opponent's material, so eval() handles it separately. It also
+   empties the pawn hash table and the eval cache. */
+
+void init_eval()
+{
+	initPHT();
+	initEC();
+	init_pcsq();
+}
 
-int eval()
+
+/* ray_att() returns the squares a piece on sq attacks in direction d,
+   with the squares in occ occupied: the ray up to and including the
+   first piece on it */
+
+static FORCEINLINE uint64 ray_att(int d, int sq, uint64 occ)
+{
+	uint64 a = ray[d][sq];
+
+	if (a & occ)
+		a ^= ray[d][(d < 4) ? LSB(a & occ) : MSB(a & occ)];
+	return a;
+}
+
+
+#ifndef __GNUC__
+/* popcount(), lsb(), and msb() are POPCOUNT(), LSB(), and MSB() for
+   compilers without the GCC builtins */
+
+int popcount(uint64 b)
+{
+	b = b - ((b >> 1) & 0x5555555555555555ULL);
+	b = (b & 0x3333333333333333ULL) + ((b >> 2) & 0x3333333333333333ULL);
+	b = (b + (b >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int)((b * 0x0101010101010101ULL) >> 56);
+}
+
+int lsb(uint64 b)
+{
+	int i = 0;
+
+	if (!(b & 0xFFFFFFFFULL)) {
+		b >>= 32;
+		i += 32;
+	}
+	if (!(b & 0xFFFF)) {
+		b >>= 16;
+		i += 16;
+	}
+	if (!(b & 0xFF)) {
+		b >>= 8;
+		i += 8;
+	}
+	while (!(b & 1)) {
+		b >>= 1;
+		++i;
+	}
+	return i;
+}
+
+int msb(uint64 b)
+{
+	int i = 0;
+
+	if (b >> 32) {
+		b >>= 32;
+		i += 32;
+	}
+	if (b >> 16) {
+		b >>= 16;
+		i += 16;
+	}
+	if (b >> 8) {
+		b >>= 8;
+		i += 8;
+	}
+	while (b >>= 1)
+		++i;
+	return i;
+}
+#endif
+
+
+/* init_pcsq() builds pcsq[][][]; tune() calls it after changing the
+   tables */
+
+void init_pcsq()
 {
 	int i;
-	int f;  /* file */
-	int score[2];  /* each side's score */
 
-	/* this is the first pass: set up pawn_rank, piece_mat, and pawn_mat. */
-	for (i = 0; i < 10; ++i) {
-		pawn_rank[LIGHT][i] = 0;
-		pawn_rank[DARK][i] = 7;
+	memset(pcsq, 0, sizeof(pcsq));
+	for (i = 0; i < 64; ++i) {
+		pcsq[LIGHT][PAWN][i] = pawn_pcsq[i];
+		pcsq[DARK][PAWN][i] = pawn_pcsq[flip[i]];
+		pcsq[LIGHT][KNIGHT][i] = knight_pcsq[i];
+		pcsq[DARK][KNIGHT][i] = knight_pcsq[flip[i]];
+		pcsq[LIGHT][BISHOP][i] = bishop_pcsq[i];
+		pcsq[DARK][BISHOP][i] = bishop_pcsq[flip[i]];
 	}
+}
+
+
+/* set_material() computes piece_mat, pawn_mat, and pcsq_mat from
+   scratch. It has to be called whenever the board is set up without
+   makemove(), just like set_hash(). */
+
+void set_material()
+{
+	int i;
+
 	piece_mat[LIGHT] = 0;
 	piece_mat[DARK] = 0;
 	pawn_mat[LIGHT] = 0;
 	pawn_mat[DARK] = 0;
+	pcsq_mat[LIGHT] = 0;
+	pcsq_mat[DARK] = 0;
 	for (i = 0; i < 64; ++i) {
-		if (color[i] == EMPTY)
+		if (COLOR(i) == EMPTY)
 			continue;
-		if (piece[i] == PAWN) {
-			pawn_mat[color[i]] += piece_value[PAWN];
-			f = COL(i) + 1;  /* add 1 because of the extra file in the array */
-			if (color[i] == LIGHT) {
-				if (pawn_rank[LIGHT][f] < ROW(i))
-					pawn_rank[LIGHT][f] = ROW(i);
-			}
-			else {
-				if (pawn_rank[DARK][f] > ROW(i))
-					pawn_rank[DARK][f] = ROW(i);
-			}
-		}
+		if (PIECE(i) == PAWN)
+			pawn_mat[COLOR(i)] += piece_value[PAWN];
 		else
-			piece_mat[color[i]] += piece_value[piece[i]];
+			piece_mat[COLOR(i)] += piece_value[PIECE(i)];
+		pcsq_mat[COLOR(i)] += pcsq[COLOR(i)][PIECE(i)][i];
 	}
+}
 
-	/* this is the second pass: evaluate each piece */
-	score[LIGHT] = piece_mat[LIGHT] + pawn_mat[LIGHT];
-	score[DARK] = piece_mat[DARK] + pawn_mat[DARK];
-	for (i = 0; i < 64; ++i) {
-		if (color[i] == EMPTY)
-			continue;
-		if (color[i] == LIGHT) {
-			switch (piece[i]) {
-				case PAWN:
-					score[LIGHT] += eval_light_pawn(i);
-					break;
-				case KNIGHT:
-					score[LIGHT] += knight_pcsq[i];
-					break;
-				case BISHOP:
-					score[LIGHT] += bishop_pcsq[i];
-					break;
+
+/* eval_pawns() fills in a pawn hash entry for the current position:
+   pawn_rank, the pawn structure score of each side (excluding the
+   piece/square values, which are in pcsq_mat), the passed pawns, and
+   the king shield for every king_zone[]. */
+
+void eval_pawns(PawnHtTyp *pe)
+{
+	int i;
+	int f;  /* file */
+	uint64 b;
+
+	pawns = pe;
+	pawn_rank = pe->rank;
+	pe->hash = pawn_hash;
+	pe->passed[LIGHT] = 0;
+	pe->passed[DARK] = 0;
+
+	/* this is the first pass: set up pawn_rank and pawn_bb */
+	for (i = 0; i < 10; ++i) {
+		pawn_rank[LIGHT][i] = 0;
+		pawn_rank[DARK][i] = 7;
+	}
+	pawn_bb[LIGHT] = MAN_MASK(LIGHT, PAWN);
+	pawn_bb[DARK] = MAN_MASK(DARK, PAWN);
+	for (b = pawn_bb[LIGHT]; b; b &= b - 1) {
+		i = LSB(b);
+		f = COL(i) + 1;  /* add 1 because of the extra file in the array */
+		if (pawn_rank[LIGHT][f] < ROW(i))
+			pawn_rank[LIGHT][f] = ROW(i);
+	}
+	for (b = pawn_bb[DARK]; b; b &= b - 1) {
+		i = LSB(b);
+		f = COL(i) + 1;
+		if (pawn_rank[DARK][f] > ROW(i))
+			pawn_rank[DARK][f] = ROW(i);
+	}
+
+	/* this is the second pass: evaluate each side's pawns */
+	pe->score[LIGHT] = (short)eval_pawn_structure(LIGHT);
+	pe->score[DARK] = (short)eval_pawn_structure(DARK);
+
+	/* the king shields, one for each place the king can be */
+	pe->shield[LIGHT][0] = (short)eval_light_shield(0);
+	pe->shield[LIGHT][1] = (short)eval_light_shield(3);
+	pe->shield[LIGHT][2] = (short)eval_light_shield(4);
+	pe->shield[LIGHT][3] = (short)eval_light_shield(7);
+	pe->shield[DARK][0] = (short)eval_dark_shield(0);
+	pe->shield[DARK][1] = (short)eval_dark_shield(3);
+	pe->shield[DARK][2] = (short)eval_dark_shield(4);
+	pe->shield[DARK][3] = (short)eval_dark_shield(7);
+}
+
+
+/* probe_pawns() points pawns and pawn_rank at the pawn hash entry for
+   the current position, calling eval_pawns() if it isn't there. */
+
+void probe_pawns()
+{
+#ifdef USE_PAWN_HASH
+	PawnHtTyp *pe = &PHT[pawn_hash & (PHT_SIZE - 1)];
+
+	++pawn_probes;
+	if (pe->hash == pawn_hash) {
+		++pawn_hits;
+		pawns = pe;
+		pawn_rank = pe->rank;
+		return;
+	}
+	eval_pawns(pe);
+#else
+	static PawnHtTyp pe;
+
+	eval_pawns(&pe);
+#endif
+}
+
+
+/* initPHT() empties the pawn hash table. Unused entries get a key that
+   no real position is going to have (pawn_hash is 0 without pawns). */
+
+void initPHT()
+{
+	int i;
+
+	memset(PHT, 0, sizeof(PHT));
+	for (i = 0; i < PHT_SIZE; ++i)
+		PHT[i].hash = (HashType)-1;
+}
+
+
+/* initEC() empties the eval cache */
+
+void initEC()
+{
+#ifdef USE_EVAL_CACHE
+	int i;
+
+	memset(EC, 0, sizeof(EC));
+	for (i = 0; i < EC_SIZE; ++i)
+		EC[i].hash = (HashType)-1;
+#endif
+}
+
+
+/* eval() returns the static evaluation of the current position,
+   relative to the side to move. The eval cache (if USE_EVAL_CACHE) is
+   tried first; full_eval() (or nnue_eval(), if the network is in use)
+   does the actual work. */
+
+int eval()
+{
+	int score;
+#ifdef USE_EVAL_CACHE
+	EvalCacheTyp *ec = &EC[hash & (EC_SIZE - 1)];
+
+	++evals;
+	if (ec->hash == hash) {
+		++eval_hits;
+		return ec->score;
+	}
+#else
+	++evals;
+#endif
+#ifdef USE_NNUE
+	if (use_nnue)
+		score = nnue_eval();
+	else
+#endif
+		score = full_eval();
+#ifdef USE_EVAL_CACHE
+	ec->hash = hash;
+	ec->score = score;
+#endif
+	return score;
+}
+
+
+/* lazy_eval() is eval() for quiesce()'s stand-pat test. Material and
+   the piece/square values are known without looking at the board; if
+   they're more than LAZY_MARGIN outside the (alpha, beta) window, the
+   remaining terms are assumed not to bring the score back inside and
+   that bound is returned. *full tells the caller whether the score is
+   a real eval() result (which can be stored) or the bound. The margin
+   is meant for the handcrafted terms, so the network is always run, and
+   tune() needs those terms, so it's off while tuning. */
+
+int lazy_eval(int alpha, int beta, BOOL *full)
+{
+	int r;
+
+	++lazy_tries;
+	r = piece_mat[side] + pawn_mat[side] + pcsq_mat[side] -
+			piece_mat[xside] - pawn_mat[xside] - pcsq_mat[xside];
+	if (!use_nnue && !tuning && (r - LAZY_MARGIN >= beta || r + LAZY_MARGIN <= alpha)) {
+		++lazy_exits;
+#ifdef LAZY_EVAL_STATS
+		{
+			int e = full_eval();
+
+			lazy_error += (e > r) ? e - r : r - e;
+			if ((r >= beta) ? (e < beta) : (e > alpha))
+				++lazy_wrong;
+		}
+#endif
+		*full = FALSE;
+		return r;
+	}
+	*full = TRUE;
+	return eval();
+}
+
+
+int full_eval()
+{
+	int i;
+	int score[2];  /* each side's score */
+	uint64 b;
+	uint64 occ[2];  /* the squares each side occupies */
+	uint64 pawn_occ[2];  /* ...with pawns */
+	int king_sq[2] = { 0, 0 };
+	int men[32];  /* the squares of the other pieces */
+	int n = 0;
+
+	/* the pawn structure comes from the pawn hash table. piece_mat,
+	   pawn_mat, and pcsq_mat are already up to date (see makemove()). */
+	probe_pawns();
+
+	/* add the terms that depend on more than the piece and its square */
+	score[LIGHT] = piece_mat[LIGHT] + pawn_mat[LIGHT] + pcsq_mat[LIGHT] +
+			pawns->score[LIGHT];
+	score[DARK] = piece_mat[DARK] + pawn_mat[DARK] + pcsq_mat[DARK] +
+			pawns->score[DARK];
+	occ[LIGHT] = SIDE_MASK(LIGHT);
+	occ[DARK] = SIDE_MASK(DARK);
+	pawn_occ[LIGHT] = MAN_MASK(LIGHT, PAWN);
+	pawn_occ[DARK] = MAN_MASK(DARK, PAWN);
+	for (b = (occ[LIGHT] | occ[DARK]) & ~(pawn_occ[LIGHT] | pawn_occ[DARK]);
+			b; b &= b - 1) {
+		i = LSB(b);
+		if (PIECE(i) == KING)
+			king_sq[COLOR(i)] = i;
+		else if (n < 32)
+			men[n++] = i;
+		if (COLOR(i) == LIGHT) {
+			switch (PIECE(i)) {
 				case ROOK:
 					if (pawn_rank[LIGHT][COL(i) + 1] == 0) {
 						if (pawn_rank[DARK][COL(i) + 1] == 7)
-							score[LIGHT] += ROOK_OPEN_FILE_BONUS;
+							score[LIGHT] += rook_open_file_bonus;
 						else
-							score[LIGHT] += ROOK_SEMI_OPEN_FILE_BONUS;
+							score[LIGHT] += rook_semi_open_file_bonus;
 					}
 					if (ROW(i) == 1)
-						score[LIGHT] += ROOK_ON_SEVENTH_BONUS;
+						score[LIGHT] += rook_on_seventh_bonus;
 					break;
 				case KING:
 					if (piece_mat[DARK] <= 1200)
@@ -180,25 +526,16 @@ int eval()
 			}
 		}
 		else {
-			switch (piece[i]) {
-				case PAWN:
-					score[DARK] += eval_dark_pawn(i);
-					break;
-				case KNIGHT:
-					score[DARK] += knight_pcsq[flip[i]];
-					break;
-				case BISHOP:
-					score[DARK] += bishop_pcsq[flip[i]];
-					break;
+			switch (PIECE(i)) {
 				case ROOK:
 					if (pawn_rank[DARK][COL(i) + 1] == 7) {
 						if (pawn_rank[LIGHT][COL(i) + 1] == 0)
-							score[DARK] += ROOK_OPEN_FILE_BONUS;
+							score[DARK] += rook_open_file_bonus;
 						else
-							score[DARK] += ROOK_SEMI_OPEN_FILE_BONUS;
+							score[DARK] += rook_semi_open_file_bonus;
 					}
 					if (ROW(i) == 6)
-						score[DARK] += ROOK_ON_SEVENTH_BONUS;
+						score[DARK] += rook_on_seventh_bonus;
 					break;
 				case KING:
 					if (piece_mat[LIGHT] <= 1200)
@@ -209,6 +546,7 @@ int eval()
 			}
 		}
 	}
+	eval_attacks(score, occ, pawn_occ, king_sq, men, n);
 
 	/* the score[] array is set, now return the score relative
 	   to the side to move */
@@ -217,90 +555,156 @@ int eval()
 	return score[DARK] - score[LIGHT];
 }
 
-int eval_light_pawn(int sq)
-{
-	int r;  /* the value to return */
-	int f;  /* the pawn's file */
+/* eval_attacks() builds each side's attack map from the occupancy
+   bitboards found by full_eval(): pawn attacks shift the pawn bitboards,
+   knight and king attacks are looked up, and sliding attacks stop at
+   the first piece on each ray. Mobility, attacks on the squares around
+   the enemy king, and hanging pieces are all scored from it. Squares
+   attacked by enemy pawns don't count towards mobility. */
 
-	r = 0;
-	f = COL(sq) + 1;
+void eval_attacks(int score[2], uint64 occ[2], uint64 pawn_occ[2],
+		int king_sq[2], int *men, int n)
+{
+	int i, c, p, sq;
+	uint64 all = occ[LIGHT] | occ[DARK];
+	uint64 att[2];  /* the squares each side attacks */
+	uint64 pawn_att[2];
+	uint64 zone[2];  /* the squares around each king */
+	uint64 a;
+	int attackers[2] = { 0, 0 };  /* pieces attacking the enemy king's zone */
+	int king_attack[2] = { 0, 0 };
+
+	pawn_att[LIGHT] = ((pawn_occ[LIGHT] & ~FILE_A) >> 9) | ((pawn_occ[LIGHT] & ~FILE_H) >> 7);
+	pawn_att[DARK] = ((pawn_occ[DARK] & ~FILE_A) << 7) | ((pawn_occ[DARK] & ~FILE_H) << 9);
+	for (c = 0; c < 2; ++c) {
+		zone[c] = king_att[king_sq[c]] | ((uint64)1 << king_sq[c]);
+		att[c] = pawn_att[c] | king_att[king_sq[c]];
+	}
 
-	r += pawn_pcsq[sq];
+	for (i = 0; i < n; ++i) {
+		sq = men[i];
+		c = COLOR(sq);
+		p = PIECE(sq);
+		switch (p) {
+			case KNIGHT:
+				a = knight_att[sq];
+				break;
+			case BISHOP:
+				a = ray_att(1, sq, all) | ray_att(3, sq, all) |
+						ray_att(5, sq, all) | ray_att(7, sq, all);
+				break;
+			case ROOK:
+				a = ray_att(0, sq, all) | ray_att(2, sq, all) |
+						ray_att(4, sq, all) | ray_att(6, sq, all);
+				break;
+			default:  /* QUEEN */
+				a = ray_att(0, sq, all) | ray_att(1, sq, all) |
+						ray_att(2, sq, all) | ray_att(3, sq, all) |
+						ray_att(4, sq, all) | ray_att(5, sq, all) |
+						ray_att(6, sq, all) | ray_att(7, sq, all);
+				break;
+		}
+		att[c] |= a;
+		score[c] += mobility_bonus[p] *
+				(POPCOUNT(a & ~occ[c] & ~pawn_att[c ^ 1]) - mobility_base[p]);
+		if (a & zone[c ^ 1]) {
+			++attackers[c];
+			king_attack[c] += king_attack_bonus[p] * POPCOUNT(a & zone[c ^ 1]);
+		}
+	}
 
-	/* if there's a pawn behind this one, it's doubled */
-	if (pawn_rank[LIGHT][f] > ROW(sq))
-		r -= DOUBLED_PAWN_PENALTY;
+	for (c = 0; c < 2; ++c) {
+		/* a lone attacker isn't much of a threat, and neither are the
+		   attackers without enough material to mate */
+		if (attackers[c] >= 2 && piece_mat[c] > 1200)
+			score[c] += king_attack[c];
 
-	/* if there aren't any friendly pawns on either side of
-	   this one, it's isolated */
-	if ((pawn_rank[LIGHT][f - 1] == 0) &&
-			(pawn_rank[LIGHT][f + 1] == 0))
-		r -= ISOLATED_PAWN_PENALTY;
+		/* the pieces (not pawns or the king) the other side can win */
+		a = occ[c] & ~pawn_occ[c] & ~((uint64)1 << king_sq[c]);
+		a &= att[c ^ 1] & (~att[c] | pawn_att[c ^ 1]);
+		score[c] -= hanging_piece_penalty * POPCOUNT(a);
+	}
+}
 
-	/* if it's not isolated, it might be backwards */
-	else if ((pawn_rank[LIGHT][f - 1] < ROW(sq)) &&
-			(pawn_rank[LIGHT][f + 1] < ROW(sq)))
-		r -= BACKWARDS_PAWN_PENALTY;
 
-	/* add a bonus if the pawn is passed */
-	if ((pawn_rank[DARK][f - 1] >= ROW(sq)) &&
-			(pawn_rank[DARK][f] >= ROW(sq)) &&
-			(pawn_rank[DARK][f + 1] >= ROW(sq)))
-		r += (7 - ROW(sq)) * PASSED_PAWN_BONUS;
+/* eval_pawn_structure() returns the pawn structure score of side c (not
+   counting the piece/square values) and marks its passed pawns. A
+   candidate passer is a pawn on a file with no enemy pawns in front that
+   has at least as many friendly pawns to support its advance as enemy
+   pawns to stop it. */
 
+int eval_pawn_structure(int c)
+{
+	int r = 0;  /* the value to return */
+	int sq;
+	int rank;  /* how far the pawn has advanced, 1 to 6 */
+	uint64 b;
+	uint64 own = pawn_bb[c];
+	uint64 enemy = pawn_bb[c ^ 1];
+
+	for (b = own; b; b &= b - 1) {
+		sq = LSB(b);
+		rank = (c == LIGHT) ? 7 - ROW(sq) : ROW(sq);
+
+		/* if there's a pawn behind this one, it's doubled */
+		if (own & front_mask[c ^ 1][sq])
+			r -= doubled_pawn_penalty;
+
+		/* if there aren't any friendly pawns on either side of
+		   this one, it's isolated */
+		if (!(own & isolated_mask[sq]))
+			r -= isolated_pawn_penalty;
+
+		/* if it's not isolated, it might be backwards */
+		else if (!(own & support_mask[c][sq]))
+			r -= backwards_pawn_penalty;
+
+		/* add a bonus if the pawn is passed, or a smaller one if it
+		   can become passed */
+		if (!(enemy & passed_mask[c][sq])) {
+			r += rank * passed_pawn_bonus;
+			pawns->passed[c] |= (uint64)1 << sq;
+		}
+		else if (!(enemy & front_mask[c][sq]) &&
+				POPCOUNT(own & support_mask[c][sq]) >= POPCOUNT(enemy & passed_mask[c][sq]))
+			r += rank * candidate_pawn_bonus;
+	}
 	return r;
 }
 
-int eval_dark_pawn(int sq)
+int eval_light_king(int sq)
 {
 	int r;  /* the value to return */
-	int f;  /* the pawn's file */
-
-	r = 0;
-	f = COL(sq) + 1;
-
-	r += pawn_pcsq[flip[sq]];
-
-	/* if there's a pawn behind this one, it's doubled */
-	if (pawn_rank[DARK][f] < ROW(sq))
-		r -= DOUBLED_PAWN_PENALTY;
-
-	/* if there aren't any friendly pawns on either side of
-	   this one, it's isolated */
-	if ((pawn_rank[DARK][f - 1] == 7) &&
-			(pawn_rank[DARK][f + 1] == 7))
-		r -= ISOLATED_PAWN_PENALTY;
 
-	/* if it's not isolated, it might be backwards */
-	else if ((pawn_rank[DARK][f - 1] > ROW(sq)) &&
-			(pawn_rank[DARK][f + 1] > ROW(sq)))
-		r -= BACKWARDS_PAWN_PENALTY;
+	r = king_pcsq[sq] + pawns->shield[LIGHT][king_zone[COL(sq)]];
 
-	/* add a bonus if the pawn is passed */
-	if ((pawn_rank[LIGHT][f - 1] <= ROW(sq)) &&
-			(pawn_rank[LIGHT][f] <= ROW(sq)) &&
-			(pawn_rank[LIGHT][f + 1] <= ROW(sq)))
-		r += ROW(sq) * PASSED_PAWN_BONUS;
+	/* scale the king safety value according to the opponent's material;
+	   the premise is that your king safety can only be bad if the
+	   opponent has enough pieces to attack you */
+	r *= piece_mat[DARK];
+	r /= 3100;
 
 	return r;
 }
 
-int eval_light_king(int sq)
+/* eval_light_shield() evaluates the pawns in front of a light king on
+   file col. It only depends on the pawns, so its result is kept in
+   the pawn hash table. */
+
+int eval_light_shield(int col)
 {
-	int r;  /* the value to return */
+	int r = 0;  /* the value to return */
 	int i;
 
-	r = king_pcsq[sq];
-
 	/* if the king is castled, use a special function to evaluate the
 	   pawns on the appropriate side */
-	if (COL(sq) < 3) {
+	if (col < 3) {
 		r += eval_lkp(1);
 		r += eval_lkp(2);
 		r += eval_lkp(3) / 2;  /* problems with pawns on the c & f files
 								  are not as severe */
 	}
-	else if (COL(sq) > 4) {
+	else if (col > 4) {
 		r += eval_lkp(8);
 		r += eval_lkp(7);
 		r += eval_lkp(6) / 2;
@@ -309,18 +713,12 @@ int eval_light_king(int sq)
 	/* otherwise, just assess a penalty if there are open files near
 	   the king */
 	else {
-		for (i = COL(sq); i <= COL(sq) + 2; ++i)
+		for (i = col; i <= col + 2; ++i)
 			if ((pawn_rank[LIGHT][i] == 0) &&
 					(pawn_rank[DARK][i] == 7))
-				r -= 10;
+				r -= shield_open_file;
 	}
 
-	/* scale the king safety value according to the opponent's material;
-	   the premise is that your king safety can only be bad if the
-	   opponent has enough pieces to attack you */
-	r *= piece_mat[DARK];
-	r /= 3100;
-
 	return r;
 }
 
@@ -332,18 +730,18 @@ int eval_lkp(int f)
 
 	if (pawn_rank[LIGHT][f] == 6);  /* pawn hasn't moved */
 	else if (pawn_rank[LIGHT][f] == 5)
-		r -= 10;  /* pawn moved one square */
+		r -= shield_pawn[0];  /* pawn moved one square */
 	else if (pawn_rank[LIGHT][f] != 0)
-		r -= 20;  /* pawn moved more than one square */
+		r -= shield_pawn[1];  /* pawn moved more than one square */
 	else
-		r -= 25;  /* no pawn on this file */
+		r -= shield_pawn[2];  /* no pawn on this file */
 
 	if (pawn_rank[DARK][f] == 7)
-		r -= 15;  /* no enemy pawn */
+		r -= shield_storm[0];  /* no enemy pawn */
 	else if (pawn_rank[DARK][f] == 5)
-		r -= 10;  /* enemy pawn on the 3rd rank */
+		r -= shield_storm[1];  /* enemy pawn on the 3rd rank */
 	else if (pawn_rank[DARK][f] == 4)
-		r -= 5;   /* enemy pawn on the 4th rank */
+		r -= shield_storm[2];  /* enemy pawn on the 4th rank */
 
 	return r;
 }
@@ -351,27 +749,34 @@ int eval_lkp(int f)
 int eval_dark_king(int sq)
 {
 	int r;
+
+	r = king_pcsq[flip[sq]] + pawns->shield[DARK][king_zone[COL(sq)]];
+	r *= piece_mat[LIGHT];
+	r /= 3100;
+	return r;
+}
+
+int eval_dark_shield(int col)
+{
+	int r = 0;
 	int i;
 
-	r = king_pcsq[flip[sq]];
-	if (COL(sq) < 3) {
+	if (col < 3) {
 		r += eval_dkp(1);
 		r += eval_dkp(2);
 		r += eval_dkp(3) / 2;
 	}
-	else if (COL(sq) > 4) {
+	else if (col > 4) {
 		r += eval_dkp(8);
 		r += eval_dkp(7);
 		r += eval_dkp(6) / 2;
 	}
 	else {
-		for (i = COL(sq); i <= COL(sq) + 2; ++i)
+		for (i = col; i <= col + 2; ++i)
 			if ((pawn_rank[LIGHT][i] == 0) &&
 					(pawn_rank[DARK][i] == 7))
-				r -= 10;
+				r -= shield_open_file;
 	}
-	r *= piece_mat[LIGHT];
-	r /= 3100;
 	return r;
 }
 
@@ -381,18 +786,18 @@ int eval_dkp(int f)
 
 	if (pawn_rank[DARK][f] == 1);
 	else if (pawn_rank[DARK][f] == 2)
-		r -= 10;
+		r -= shield_pawn[0];
 	else if (pawn_rank[DARK][f] != 7)
-		r -= 20;
+		r -= shield_pawn[1];
 	else
-		r -= 25;
+		r -= shield_pawn[2];
 
 	if (pawn_rank[LIGHT][f] == 0)
-		r -= 15;
+		r -= shield_storm[0];
 	else if (pawn_rank[LIGHT][f] == 2)
-		r -= 10;
+		r -= shield_storm[1];
 	else if (pawn_rank[LIGHT][f] == 3)
-		r -= 5;
+		r -= shield_storm[2];
 
 	return r;
 }
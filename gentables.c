@@ -0,0 +1,280 @@
+/*
+ *	GENTABLES.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Generating tables.c
+ */
+
+
+/* The hash keys and the bitboard tables never change, so instead of
+   being computed every time the program starts, they're written out
+   once as constant arrays in tables.c. The compiler puts them in
+   read-only memory, which every running copy of the program shares.
+   After one of the functions below is changed, "tables file" runs
+   write_tables() to write a new tables.c to file, which then replaces
+   the one in the source tree. */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+static HashType key_piece[2][6][64];
+static HashType key_side;
+static HashType key_ep[64];
+static HashType key_castle[16];
+static uint64 gen_front[2][64];
+static uint64 gen_passed[2][64];
+static uint64 gen_support[2][64];
+static uint64 gen_isolated[64];
+static uint64 gen_knight[64];
+static uint64 gen_king[64];
+static uint64 gen_ray[8][64];
+
+static uint64 hash_seed;  /* the state of hash_rand() */
+
+
+/* hash_rand() returns the next number of SplitMix64 (Steele, Lea, and
+   Flood, "Fast Splittable Pseudorandom Number Generators," 2014), whose
+   64-bit outputs pass the BigCrush tests. It always starts from the
+   same seed, so the keys are the same every time. */
+
+HashType hash_rand()
+{
+	uint64 z = (hash_seed += 0x9E3779B97F4A7C15ULL);
+
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+
+/* gen_hash() makes the random numbers used by set_hash(), and the
+   castle keys used by book_key(): one for each castle permission, XORed
+   together for each value of castle */
+
+static void gen_hash()
+{
+	int i, j, k;
+	HashType c[4];
+
+	hash_seed = 0;
+	for (i = 0; i < 2; ++i)
+		for (j = 0; j < 6; ++j)
+			for (k = 0; k < 64; ++k)
+				key_piece[i][j][k] = hash_rand();
+	key_side = hash_rand();
+	for (i = 0; i < 64; ++i)
+		key_ep[i] = hash_rand();
+	for (i = 0; i < 4; ++i)
+		c[i] = hash_rand();
+	for (i = 0; i < 16; ++i) {
+		key_castle[i] = 0;
+		for (j = 0; j < 4; ++j)
+			if (i & (1 << j))
+				key_castle[i] ^= c[j];
+	}
+}
+
+
+/* hash_keys_ok() checks the keys made by gen_hash(): they have to be
+   nonzero and all different, and each bit has to be set in about half
+   of them. */
+
+BOOL hash_keys_ok()
+{
+	HashType *keys = &key_piece[0][0][0];
+	int n = 2 * 6 * 64;
+	int i, j, b, c;
+
+	for (i = 0; i < n; ++i) {
+		if (!keys[i] || keys[i] == key_side)
+			return FALSE;
+		for (j = 0; j < i; ++j)
+			if (keys[i] == keys[j])
+				return FALSE;
+	}
+	for (b = 0; b < 64; ++b) {
+		c = 0;
+		for (i = 0; i < n; ++i)
+			if (keys[i] & ((HashType)1 << b))
+				++c;
+		if (c < n * 4 / 10 || c > n * 6 / 10)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+/* gen_masks() makes the pawn masks (see eval.c). Rows count from the
+   8th rank, so LIGHT's "in front" is a smaller row. */
+
+static void gen_masks()
+{
+	int sq, i, f;
+	uint64 b;
+
+	for (sq = 0; sq < 64; ++sq)
+		for (i = 0; i < 64; ++i) {
+			f = COL(i) - COL(sq);
+			if (f < -1 || f > 1)
+				continue;
+			b = (uint64)1 << i;
+			if (f == 0) {
+				if (ROW(i) < ROW(sq))
+					gen_front[LIGHT][sq] |= b;
+				if (ROW(i) > ROW(sq))
+					gen_front[DARK][sq] |= b;
+			}
+			if (ROW(i) < ROW(sq))
+				gen_passed[LIGHT][sq] |= b;
+			if (ROW(i) > ROW(sq))
+				gen_passed[DARK][sq] |= b;
+			if (f != 0) {
+				gen_isolated[sq] |= b;
+				if (ROW(i) >= ROW(sq))
+					gen_support[LIGHT][sq] |= b;
+				if (ROW(i) <= ROW(sq))
+					gen_support[DARK][sq] |= b;
+			}
+		}
+}
+
+
+/* gen_attacks() makes knight_att[], king_att[], and ray[][] from the
+   mailbox offsets the move generator uses */
+
+static void gen_attacks()
+{
+	/* the directions of ray[], as offsets in mailbox[] */
+	static int dir[8] = { 1, 9, 10, 11, -1, -9, -10, -11 };
+	int sq, d, i, to;
+
+	for (sq = 0; sq < 64; ++sq) {
+		for (i = 0; i < offsets[KNIGHT]; ++i) {
+			to = mailbox[mailbox64[sq] + offset[KNIGHT][i]];
+			if (to != -1)
+				gen_knight[sq] |= (uint64)1 << to;
+		}
+		for (i = 0; i < offsets[KING]; ++i) {
+			to = mailbox[mailbox64[sq] + offset[KING][i]];
+			if (to != -1)
+				gen_king[sq] |= (uint64)1 << to;
+		}
+		for (d = 0; d < 8; ++d)
+			for (to = mailbox[mailbox64[sq] + dir[d]]; to != -1;
+					to = mailbox[mailbox64[to] + dir[d]])
+				gen_ray[d][sq] |= (uint64)1 << to;
+	}
+}
+
+
+/* write_array() writes the numbers at a as the initializer of a C
+   array with the n dimensions in dim, indented by depth tabs. The
+   innermost arrays get four numbers to a line. */
+
+static const uint64 *write_array(FILE *f, const uint64 *a, const int *dim,
+		int n, int depth)
+{
+	int i, j;
+
+	fprintf(f, "{\n");
+	for (i = 0; i < dim[0]; ++i) {
+		if (n > 1) {
+			for (j = 0; j <= depth; ++j)
+				fprintf(f, "\t");
+			a = write_array(f, a, dim + 1, n - 1, depth + 1);
+		}
+		else {
+			if (i % 4 == 0)
+				for (j = 0; j <= depth; ++j)
+					fprintf(f, "\t");
+			fprintf(f, "0x%016llXULL", *a++);
+		}
+		if (i < dim[0] - 1)
+			fprintf(f, ",");
+		fprintf(f, (n > 1 || i % 4 == 3 || i == dim[0] - 1) ? "\n" : " ");
+	}
+	for (j = 0; j < depth; ++j)
+		fprintf(f, "\t");
+	fprintf(f, "}");
+	return a;
+}
+
+
+/* write_table() writes the definition of a table, whose type and name
+   are in decl */
+
+static void write_table(FILE *f, char *decl, const uint64 *a, int d0, int d1,
+		int d2)
+{
+	int dim[3];
+	int n = 0;
+
+	dim[n++] = d0;
+	if (d1)
+		dim[n++] = d1;
+	if (d2)
+		dim[n++] = d2;
+	fprintf(f, "%s", decl);
+	for (d0 = 0; d0 < n; ++d0)
+		fprintf(f, "[%d]", dim[d0]);
+	fprintf(f, " = ");
+	write_array(f, a, dim, n, 0);
+	fprintf(f, ";\n\n");
+}
+
+
+/* write_tables() writes tables.c to the file s */
+
+void write_tables(char *s)
+{
+	FILE *f;
+
+	memset(gen_front, 0, sizeof(gen_front));
+	memset(gen_passed, 0, sizeof(gen_passed));
+	memset(gen_support, 0, sizeof(gen_support));
+	memset(gen_isolated, 0, sizeof(gen_isolated));
+	memset(gen_knight, 0, sizeof(gen_knight));
+	memset(gen_king, 0, sizeof(gen_king));
+	memset(gen_ray, 0, sizeof(gen_ray));
+	gen_hash();
+	if (!hash_keys_ok()) {
+		printf("The hash keys are no good; %s wasn't written.\n", s);
+		return;
+	}
+	gen_masks();
+	gen_attacks();
+
+	f = fopen(s, "w");
+	if (!f) {
+		printf("Can't write %s.\n", s);
+		return;
+	}
+	fprintf(f, "/*\n");
+	fprintf(f, " *\tTABLES.C\n");
+	fprintf(f, " *\tTom Kerrigan's Simple Chess Program (TSCP)\n");
+	fprintf(f, " *\n");
+	fprintf(f, " *\tConstant tables, written by the \"tables\" command; see gentables.c\n");
+	fprintf(f, " */\n\n\n");
+	fprintf(f, "#include \"defs.h\"\n\n");
+	fprintf(f, "/* random numbers used to compute hash; see set_hash() in board.c */\n");
+	write_table(f, "const HashType hash_piece", &key_piece[0][0][0], 2, 6, 64);
+	fprintf(f, "const HashType hash_side = 0x%016llXULL;\n\n", key_side);
+	write_table(f, "const HashType hash_ep", key_ep, 64, 0, 0);
+	write_table(f, "const HashType hash_castle", key_castle, 16, 0, 0);
+	fprintf(f, "/* the pawn masks; see eval.c */\n");
+	write_table(f, "const uint64 front_mask", &gen_front[0][0], 2, 64, 0);
+	write_table(f, "const uint64 passed_mask", &gen_passed[0][0], 2, 64, 0);
+	write_table(f, "const uint64 support_mask", &gen_support[0][0], 2, 64, 0);
+	write_table(f, "const uint64 isolated_mask", gen_isolated, 64, 0, 0);
+	fprintf(f, "/* the attack tables; see eval.c */\n");
+	write_table(f, "const uint64 knight_att", gen_knight, 64, 0, 0);
+	write_table(f, "const uint64 king_att", gen_king, 64, 0, 0);
+	write_table(f, "const uint64 ray", &gen_ray[0][0], 8, 64, 0);
+	fclose(f);
+	printf("Tables written to %s.\n", s);
+}
@@ -10,23 +10,52 @@
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>  /* before defs.h, which defines BOOL */
+#endif
 #include "defs.h"
 #include "data.h"
 #include "protos.h"
 
 
-/* get_ms() returns the milliseconds elapsed since midnight,
-   January 1, 1970. */
+/* startup_ns is the wall time main() took to get to the first prompt
+   (including loading the network and the book, and waiting for the
+   disk); bench prints it */
+long long startup_ns;
+
+
+/* get_ns() returns nanoseconds from a steady clock with an arbitrary
+   start. Unlike the time of day, it never jumps when the clock is set,
+   so the differences between two readings can be trusted. */
+
+#ifdef _WIN32
+long long get_ns()
+{
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER t;
+
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&t);
+	return (long long)((double)t.QuadPart * 1e9 / (double)freq.QuadPart);
+}
+#else
+long long get_ns()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (long long)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+#endif
+
+
+/* get_ms() returns milliseconds from the same clock */
 
-#include <sys/timeb.h>
-BOOL ftime_ok = FALSE;  /* does ftime return milliseconds? */
 long long get_ms()
 {
-	struct timeb timebuffer;
-	ftime(&timebuffer);
-	if (timebuffer.millitm != 0)
-		ftime_ok = TRUE;
-	return (timebuffer.time * 1000) + timebuffer.millitm;
+	return get_ns() / 1000000;
 }
 
 
@@ -40,6 +69,7 @@ int main()
 	char s[256];
 	int m;
 
+	startup_ns = get_ns();
 	printf("\n");
 	printf("Tom Kerrigan's Simple Chess Program (TSCP)\n");
 	printf("version 1.81c, 10/02/2021 HASH\n");
@@ -47,11 +77,15 @@ int main()
 	printf("\n");
 	printf("\"help\" displays a list of commands.\n");
 	printf("\n");
-	init_hash();
+	init_eval();
 	init_board();
+#ifdef USE_NNUE
+	if (nnue_load(NNUE_FILE))
+		printf("Neural network loaded from %s.\n", NNUE_FILE);
+#endif
 	open_book();
 	gen();
-	initHT();
+	startup_ns = get_ns() - startup_ns;  /* from the start of main() */
 	computer_side = EMPTY;
 	max_time = 1 << 25;
 	max_depth = 7;
@@ -60,13 +94,13 @@ int main()
 			
 			/* think about the move and make it */
 			think(1);
-			if (!pv[0][0].u) {
+			if (!pv[0][0]) {
 				printf("(no legal moves)\n");
 				computer_side = EMPTY;
 				continue;
 			}
-			printf("Computer's move: %s\n", move_str(pv[0][0].b));
-			makemove(pv[0][0].b);
+			printf("Computer's move: %s\n", move_str(pv[0][0]));
+			makemove(pv[0][0]);
 			ply = 0;
 			gen();
 			print_result();
@@ -89,11 +123,28 @@ int main()
 			scanf("%lld", &max_time);
 			max_time *= 1000;
 			max_depth = 32;
+			max_nodes = 0;
 			continue;
 		}
 		if (!strcmp(s, "sd")) {
 			scanf("%d", &max_depth);
 			max_time = 1 << 25;
+			max_nodes = 0;
+			continue;
+		}
+		if (!strcmp(s, "sn")) {
+			scanf("%llu", &max_nodes);
+			max_time = 1 << 25;
+			max_depth = 32;
+			continue;
+		}
+		if (!strcmp(s, "deterministic")) {
+			deterministic = !deterministic;
+			printf("Deterministic mode %s.\n", deterministic ? "on" : "off");
+			continue;
+		}
+		if (!strcmp(s, "latency")) {
+			print_latency();
 			continue;
 		}
 		if (!strcmp(s, "undo")) {
@@ -120,6 +171,107 @@ int main()
 			bench();
 			continue;
 		}
+		if (!strcmp(s, "makebook")) {
+			scanf("%s", s);
+			computer_side = EMPTY;
+			make_book(s);
+			gen();
+			continue;
+		}
+		if (!strcmp(s, "suite")) {
+			int depth = SUITE_DEPTH, mb = SUITE_MB, threads = 1;
+
+			if (fgets(s, sizeof(s), stdin))
+				sscanf(s, "%d %d %d", &depth, &mb, &threads);
+			computer_side = EMPTY;
+			suite(depth, mb, threads);
+			continue;
+		}
+		if (!strcmp(s, "epd")) {
+			char file[256], limit[32];
+			double sec;
+			int n;
+
+			computer_side = EMPTY;
+			n = fgets(s, sizeof(s), stdin) ? sscanf(s, "%255s %31s", file, limit) : 0;
+			if (n < 1)
+				printf("Usage: epd file [time|depth]\n");
+			else if (n < 2)
+				epd(file, EPD_TIME, 0);
+			else if (strchr(limit, 's') && sscanf(limit, "%lf", &sec) == 1)
+				epd(file, (long long)(sec * 1000.0), 0);
+			else
+				epd(file, 0, atoi(limit));
+			gen();
+			continue;
+		}
+		if (!strcmp(s, "microbench")) {
+			char file[256];
+
+			computer_side = EMPTY;
+			if (fgets(s, sizeof(s), stdin) && sscanf(s, "%255s", file) == 1)
+				microbench(file);
+			else
+				microbench(NULL);
+			gen();
+			continue;
+		}
+		if (!strcmp(s, "tables")) {
+			char file[256];
+
+			if (fgets(s, sizeof(s), stdin) && sscanf(s, "%255s", file) == 1)
+				write_tables(file);
+			else
+				printf("Usage: tables file\n");
+			continue;
+		}
+#ifdef TRACE
+		if (!strcmp(s, "trace")) {
+			char file[256];
+
+			if (trace_on)
+				printf("Tracing stopped; %llu nodes traced.\n", trace_close());
+			else {
+				if (!fgets(s, sizeof(s), stdin) || sscanf(s, "%255s", file) != 1)
+					strcpy(file, TRACE_FILE);
+				if (trace_open(file))
+					printf("Tracing the search to %s.\n", file);
+				else
+					printf("Can't write %s.\n", file);
+			}
+			continue;
+		}
+#endif
+		if (!strcmp(s, "tracestat")) {
+			char file[256];
+
+			if (!fgets(s, sizeof(s), stdin) || sscanf(s, "%255s", file) != 1)
+				strcpy(file, TRACE_FILE);
+			trace_stat(file);
+			continue;
+		}
+		if (!strcmp(s, "tune")) {
+			scanf("%s", s);
+			computer_side = EMPTY;
+			tune(s);
+			gen();
+			continue;
+		}
+#ifdef USE_NNUE
+		if (!strcmp(s, "nnue")) {
+			if (nnue_loaded) {
+				use_nnue = !use_nnue;
+
+				/* the eval cache, and the static evals and scores in the
+				   hash table, came from the other evaluator */
+				initEC();
+				initHT();
+				tt_age = 0;
+			}
+			printf("Evaluation: %s\n", use_nnue ? "neural network" : "handcrafted");
+			continue;
+		}
+#endif
 		if (!strcmp(s, "bye")) {
 			printf("Share and enjoy!\n");
 			break;
@@ -133,10 +285,31 @@ int main()
 			printf("off - computer stops playing\n");
 			printf("st n - search for n seconds per move\n");
 			printf("sd n - search n ply per move\n");
+			printf("sn n - search n nodes per move\n");
+			printf("deterministic - switch repeatable searches on or off: no book, empty\n");
+			printf("    hash tables before each search, and one thread at a time\n");
+			printf("latency - show how far the searches with a time limit went past it\n");
 			printf("undo - takes back a move\n");
 			printf("new - starts a new game\n");
 			printf("d - display the board\n");
 			printf("bench - run the built-in benchmark\n");
+			printf("suite [d [m [t]]] - search the benchmark positions to d ply with m MB of\n");
+			printf("    hash and t threads, and print the node count signature\n");
+			printf("tune file - tune the evaluation to the results in an EPD file\n");
+			printf("makebook file - make the opening book from the games in a PGN file\n");
+			printf("epd file [time|depth] - solve the positions of an EPD file, searching each\n");
+			printf("    for a time in seconds (\"10s\"), %d s by default, or to a depth\n", EPD_TIME / 1000);
+			printf("microbench [file] - time gen(), eval(), etc. one at a time, on the\n");
+			printf("    benchmark positions or those of an EPD file\n");
+			printf("tables file - write the constant tables to file (a new tables.c)\n");
+#ifdef TRACE
+			printf("trace [file] - start writing the search tree to file (%s by\n", TRACE_FILE);
+			printf("    default), or stop if it's being written\n");
+#endif
+			printf("tracestat [file] - summarize a search tree written by trace\n");
+#ifdef USE_NNUE
+			printf("nnue - switch between the neural network and handcrafted evaluation\n");
+#endif
 			printf("bye - exit the program\n");
 			printf("xboard - switch to XBoard mode\n");
 			printf("Enter moves in coordinate notation, e.g., e2e4, e7e8Q\n");
@@ -145,7 +318,7 @@ int main()
 
 		/* maybe the user entered a move? */
 		m = parse_move(s);
-		if (m == -1 || !makemove(gen_dat[m].m.b))
+		if (m == -1 || !makemove(gen_move[m]))
 			printf("Illegal move.\n");
 		else {
 			ply = 0;
@@ -159,7 +332,7 @@ int main()
 
 
 /* parse the move s (in coordinate notation) and return the move's
-   index in gen_dat, or -1 if the move is illegal */
+   index in gen_move, or -1 if the move is illegal */
 
 int parse_move(char *s)
 {
@@ -178,12 +351,12 @@ int parse_move(char *s)
 	to += 8 * (8 - (s[3] - '0'));
 
 	for (i = 0; i < first_move[1]; ++i)
-		if (gen_dat[i].m.b.from == from && gen_dat[i].m.b.to == to) {
+		if (MOVE_FROM(gen_move[i]) == from && MOVE_TO(gen_move[i]) == to) {
 
 			/* if the move is a promotion, handle the promotion piece;
 			   assume that the promotion moves occur consecutively in
-			   gen_dat. */
-			if (gen_dat[i].m.b.bits & 32)
+			   gen_move. */
+			if (MOVE_PROMOTE(gen_move[i]))
 				switch (s[4]) {
 					case 'N':
 					case 'n':
@@ -207,14 +380,14 @@ int parse_move(char *s)
 
 /* move_str returns a string with move m in coordinate notation */
 
-char *move_str(move_bytes m)
+char *move_str(move m)
 {
 	static char str[6];
 
 	char c;
 
-	if (m.bits & 32) {
-		switch (m.promote) {
+	if (MOVE_PROMOTE(m)) {
+		switch (MOVE_PROMOTE(m)) {
 			case KNIGHT:
 				c = 'n';
 				break;
@@ -229,18 +402,18 @@ char *move_str(move_bytes m)
 				break;
 		}
 		sprintf(str, "%c%d%c%d%c",
-				COL(m.from) + 'a',
-				8 - ROW(m.from),
-				COL(m.to) + 'a',
-				8 - ROW(m.to),
+				COL(MOVE_FROM(m)) + 'a',
+				8 - ROW(MOVE_FROM(m)),
+				COL(MOVE_TO(m)) + 'a',
+				8 - ROW(MOVE_TO(m)),
 				c);
 	}
 	else
 		sprintf(str, "%c%d%c%d",
-				COL(m.from) + 'a',
-				8 - ROW(m.from),
-				COL(m.to) + 'a',
-				8 - ROW(m.to));
+				COL(MOVE_FROM(m)) + 'a',
+				8 - ROW(MOVE_FROM(m)),
+				COL(MOVE_TO(m)) + 'a',
+				8 - ROW(MOVE_TO(m)));
 	return str;
 }
 
@@ -253,15 +426,15 @@ void print_board()
 	
 	printf("\n8 ");
 	for (i = 0; i < 64; ++i) {
-		switch (color[i]) {
+		switch (COLOR(i)) {
 			case EMPTY:
 				printf(" .");
 				break;
 			case LIGHT:
-				printf(" %c", piece_char[piece[i]]);
+				printf(" %c", piece_char[PIECE(i)]);
 				break;
 			case DARK:
-				printf(" %c", piece_char[piece[i]] + ('a' - 'A'));
+				printf(" %c", piece_char[PIECE(i)] + ('a' - 'A'));
 				break;
 		}
 		if ((i + 1) % 8 == 0 && i != 63)
@@ -291,12 +464,12 @@ void xboard()
 		fflush(stdout);
 		if (side == computer_side) {
 			think(post);
-			if (!pv[0][0].u) {
+			if (!pv[0][0]) {
 				computer_side = EMPTY;
 				continue;
 			}
-			printf("move %s\n", move_str(pv[0][0].b));
-			makemove(pv[0][0].b);
+			printf("move %s\n", move_str(pv[0][0]));
+			makemove(pv[0][0]);
 			ply = 0;
 			gen();
 			print_result();
@@ -339,11 +512,19 @@ void xboard()
 			sscanf(line, "st %lld", &max_time);
 			max_time *= 1000;
 			max_depth = 32;
+			max_nodes = 0;
 			continue;
 		}
 		if (!strcmp(command, "sd")) {
 			sscanf(line, "sd %d", &max_depth);
 			max_time = 1 << 25;
+			max_nodes = 0;
+			continue;
+		}
+		if (!strcmp(command, "sn")) {
+			sscanf(line, "sn %llu", &max_nodes);
+			max_time = 1 << 25;
+			max_depth = 32;
 			continue;
 		}
 		if (!strcmp(command, "time")) {
@@ -351,20 +532,29 @@ void xboard()
 			max_time *= 10;
 			max_time /= 30;
 			max_depth = 32;
+			max_nodes = 0;
 			continue;
 		}
 		if (!strcmp(command, "otim")) {
 			continue;
 		}
 		if (!strcmp(command, "go")) {
+			if (sscanf(line, "go nodes %llu", &max_nodes) == 1) {
+				max_time = 1 << 25;
+				max_depth = 32;
+			}
 			computer_side = side;
 			continue;
 		}
+		if (!strcmp(command, "deterministic")) {
+			deterministic = !deterministic;
+			continue;
+		}
 		if (!strcmp(command, "hint")) {
 			think(0);
-			if (!pv[0][0].u)
+			if (!pv[0][0])
 				continue;
-			printf("Hint: %s\n", move_str(pv[0][0].b));
+			printf("Hint: %s\n", move_str(pv[0][0]));
 			continue;
 		}
 		if (!strcmp(command, "undo")) {
@@ -393,7 +583,7 @@ void xboard()
 			continue;
 		}
 		m = parse_move(line);
-		if (m == -1 || !makemove(gen_dat[m].m.b))
+		if (m == -1 || !makemove(gen_move[m]))
 			printf("Error (unknown command): %s\n", command);
 		else {
 			ply = 0;
@@ -413,7 +603,7 @@ void print_result()
 
 	/* is there a legal move? */
 	for (i = 0; i < first_move[1]; ++i)
-		if (makemove(gen_dat[i].m.b)) {
+		if (makemove(gen_move[i])) {
 			takeback();
 			break;
 		}
@@ -463,19 +653,23 @@ int bench_piece[64] = {
 	3, 6, 2, 6, 3, 6, 5, 6
 };
 
+#define BENCH_EVALS 1000000
+
 void bench()
 {
 	int i;
 	long long  t[3]; // Temps en ms
-	double nps;
+	long long  te;   // Temps des appels a eval() en ms
+	unsigned long long search_evals;
+	double nps, ns;
+	volatile int sink = 0;
 
 	/* setting the position to a non-initial position confuses the opening
 	   book code. */
 	close_book();
 
 	for (i = 0; i < 64; ++i) {
-		color[i] = bench_color[i];
-		piece[i] = bench_piece[i];
+		board[i] = MAN(bench_color[i], bench_piece[i]);
 	}
 	side = LIGHT;
 	xside = DARK;
@@ -485,13 +679,16 @@ void bench()
 	ply = 0;
 	hply = 0;
 	set_hash();
+	set_material();
+#ifdef USE_NNUE
+	nnue_reset();
+#endif
 	print_board();
 	max_time = 1 << 25;
 	max_depth = 6;
-	initHT(); 
+	max_nodes = 0;
 	for (i = 0; i < 3; ++i) {
-		//initHT(); // Plac l pour obtenir les mmes performances pour chaque bench
-		            // Sinon, sortir de la boucle et mettre au-dessus
+		initHT();  /* so that each run searches the same tree */
 		think(1);
 		t[i] = get_ms() - start_time;
 		printf("Time: %lld ms\n", t[i]);
@@ -503,14 +700,6 @@ void bench()
 	printf("\n");
 	printf("Nodes: %lld\n", nodes);
 	printf("Best time: %lld ms\n", t[0]);
-	if (!ftime_ok) {
-		printf("\n");
-		printf("Your compiler's ftime() function is apparently only accurate\n");
-		printf("to the second. Please change the get_ms() function in main.c\n");
-		printf("to make it more accurate.\n");
-		printf("\n");
-		return;
-	}
 	if (t[0] == 0) {
 		printf("(invalid)\n");
 		return;
@@ -521,7 +710,251 @@ void bench()
 	/* Score: 1.000 = my Athlon XP 2000+ */
 	printf("Nodes per second: %d (Score: %.3f)\n", (int)nps, (float)nps/243169.0);
 
+	if (tt_probes) {
+		printf("Hash table: %lld probes, %.2f%% hits\n", tt_probes,
+				100.0 * (double)tt_hits / (double)tt_probes);
+		printf("Hash table moves that can't be played: %.2f per million probes\n",
+				1000000.0 * (double)tt_bad_moves / (double)tt_probes);
+#ifdef HASH_STATS
+		printf("Hash table collisions: %.2f per million probes\n",
+				1000000.0 * (double)tt_collisions / (double)tt_probes);
+#endif
+	}
+	if (pawn_probes)
+		printf("Pawn hash: %lld probes, %.2f%% hits\n", pawn_probes,
+				100.0 * (double)pawn_hits / (double)pawn_probes);
+	if (evals + tt_evals)
+		printf("Evals avoided: %.2f%% (%lld from the eval cache, %lld from the hash table)\n",
+				100.0 * (double)(eval_hits + tt_evals) / (double)(evals + tt_evals),
+				eval_hits, tt_evals);
+	if (lazy_tries) {
+		printf("Lazy eval: %lld exits (%.2f%% of stand-pat evals)\n", lazy_exits,
+				100.0 * (double)lazy_exits / (double)lazy_tries);
+#ifdef LAZY_EVAL_STATS
+		if (lazy_exits)
+			printf("Lazy eval: %lld wrong side of the window (%.2f%%), mean error %.1f\n",
+					lazy_wrong, 100.0 * (double)lazy_wrong / (double)lazy_exits,
+					(double)lazy_error / (double)lazy_exits);
+#endif
+	}
+
+	/* estimate how much of the search went into eval(): time a batch of
+	   evaluations on the bench position and scale it by the number of
+	   evaluations actually computed during the best run */
+	search_evals = evals - eval_hits;
+	te = get_ms();
+	for (i = 0; i < BENCH_EVALS; ++i)
+		sink += full_eval();
+	te = get_ms() - te;
+	ns = (double)te * 1000000.0 / BENCH_EVALS;
+	printf("Evals per second: %.0f handcrafted", 1e9 / ns);
+#ifdef USE_NNUE
+	if (nnue_loaded) {
+		double ns_nnue, ns_refresh;
+
+		/* the accumulator is up to date after the first call, so
+		   this times the dense layers; then time it with a refresh
+		   of the accumulator each time */
+		te = get_ms();
+		for (i = 0; i < BENCH_EVALS; ++i)
+			sink += nnue_eval();
+		te = get_ms() - te;
+		ns_nnue = (double)te * 1000000.0 / BENCH_EVALS;
+		te = get_ms();
+		for (i = 0; i < BENCH_EVALS / 10; ++i) {
+			nnue_reset();
+			sink += nnue_eval();
+		}
+		te = get_ms() - te;
+		ns_refresh = (double)te * 10000000.0 / BENCH_EVALS;
+		printf(", %.0f NNUE (%.0f with an accumulator refresh)", 1e9 / ns_nnue,
+				1e9 / ns_refresh);
+		if (use_nnue)
+			ns = ns_nnue;
+	}
+#endif
+	printf("\n");
+	printf("Evals: %lld computed (%.0f ns each, %.1f%% of search time)\n", search_evals,
+			ns, 100.0 * ns * (double)search_evals / ((double)t[0] * 1000000.0));
+	printf("Startup: %.2f ms\n", (double)startup_ns / 1000000.0);
+
 	init_board();
 	open_book();
 	gen();
 }
+
+
+/* suite: the "suite" command searches the positions in bench_fen[] to a
+   fixed depth, each one with an empty hash table, and prints the total
+   number of nodes. That number only changes when the search does, so
+   it's a signature to check changes that shouldn't alter the search
+   against. The positions can be split between threads, each with its
+   own slice of the hash table; the hash size is per thread, so the
+   signature doesn't depend on the number of threads. The time, nodes,
+   and speed of each position are also written to SUITE_FILE in JSON. */
+
+char *bench_fen[] = {
+	/* the opening */
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"rnbqkb1r/pp3ppp/4pn2/2pp4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 0 5",
+	"r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w KQkq - 4 4",
+	"rnbqk2r/ppp1bppp/4pn2/3p4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 4 5",
+	"r1bqk2r/pp2bppp/2nppn2/8/3NP3/2N1B3/PPP1BPPP/R2QK2R w KQkq - 2 8",
+
+	/* the middlegame */
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+	"4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+	"rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+	"r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+	"r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+	"r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+	"r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+	"4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+	"2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+	"r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+	"3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+	"r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+	"4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+	"3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+	"6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+	"r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+	"r2q1rk1/pp1bppbp/2np1np1/8/2BNP3/2N1BP2/PPPQ2PP/R3K2R w KQ - 2 10",
+	"2kr3r/pp1q1ppp/2n1pn2/3p4/3P4/2PBPN2/P1Q2PPP/R4RK1 w - - 0 14",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"2r3k1/1q3ppp/p3p3/1p1nP3/3P4/P2Q1N2/1P3PPP/2R3K1 w - - 0 25",
+	"3r1k2/4npp1/1ppr3p/p6P/P2PPPP1/1NR5/5K2/2R5 w - - 0 1",
+	"2q1rr1k/3bbnnp/p2p1pp1/2pPp3/PpP1P1P1/1P2BNNP/2BQ1PRK/7R b - - 0 1",
+	"r1b2rk1/2q1b1pp/p2ppn2/1p6/3QP3/1BN1B3/PPP3PP/R4RK1 w - - 0 1",
+	"2r1nrk1/p2q1ppp/bp1p4/n1pPp3/P1P1P3/2PBB1N1/4QPPP/R4RK1 w - - 0 1",
+
+	/* tactics */
+	"1k1r4/pp1b1R2/3q2pp/4p3/2B5/4Q3/PPP2B2/2K5 b - - 0 1",
+	"rnbqkb1r/p3pppp/1p6/2ppP3/3N4/2P5/PPP1QPPP/R1B1KB1R w KQkq - 0 1",
+
+	/* the endgame */
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+	"6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 0 1",
+	"8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+	"8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+	"8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+	"8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+	"8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+	"8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+	"8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+	"8/8/p1p5/1p5p/1P5p/8/PPP2K1p/4R1rk w - - 0 1",
+	"8/pp2r1k1/2p1p3/3pP2p/3P1PpP/2P3K1/PP2R3/8 w - - 0 1",
+	"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1",
+	"8/8/8/4k3/8/8/8/R3K3 w Q - 0 1",
+	"8/5pk1/7p/3R4/5PP1/1r5P/5K2/8 w - - 0 1",
+	NULL
+};
+
+#define SUITE_POSITIONS ((int)(sizeof(bench_fen) / sizeof(bench_fen[0])) - 1)
+
+/* the result of searching a position of the suite */
+typedef struct {
+	unsigned long long nodes;
+	long long ms;
+	move best;
+} suite_result_t;
+
+/* what the threads of the suite are told to do */
+typedef struct {
+	int threads;
+	int depth;
+	unsigned int buckets;  /* the size of each thread's slice of HT[] */
+	suite_result_t r[SUITE_POSITIONS];
+} suite_t;
+
+
+/* suite_slice() is the work of thread i in suite(): every threads-th
+   position, starting with the i-th */
+
+static void suite_slice(int i, void *arg)
+{
+	suite_t *s = (suite_t *)arg;
+	int n;
+
+	tt_table = HT + (size_t)i * s->buckets;
+	tt_buckets = s->buckets;
+	for (n = i; n < SUITE_POSITIONS; n += s->threads) {
+		set_fen(bench_fen[n]);
+		initHT();
+		initPHT();
+		initEC();
+		max_time = 1 << 25;
+		max_depth = s->depth;
+		think(0);
+		s->r[n].nodes = nodes;
+		s->r[n].ms = get_ms() - start_time;
+		s->r[n].best = pv[0][0];
+	}
+}
+
+
+/* suite() is the "suite" command: depth is the search depth, mb the
+   hash table size of each thread in MB, and threads the number of
+   threads */
+
+void suite(int depth, int mb, int threads)
+{
+	static suite_t s;
+	FILE *f;
+	unsigned long long total = 0;
+	long long t;
+	double nps;
+	int i;
+
+	if (threads < 1)
+		threads = 1;
+	if (threads > MAX_THREADS)
+		threads = MAX_THREADS;
+	if (mb < 1)
+		mb = 1;
+	if ((long long)mb * threads * 1048576 > (long long)sizeof(HT)) {
+		mb = (int)(sizeof(HT) / 1048576 / threads);
+		printf("The hash table is %d MB, so each thread gets %d MB.\n",
+				(int)(sizeof(HT) / 1048576), mb);
+	}
+	s.threads = threads;
+	s.depth = depth;
+	s.buckets = (unsigned int)((long long)mb * 1048576 / sizeof(HtBucket));
+
+	close_book();  /* book moves would stop think() from searching */
+	t = get_ms();
+	run_threads(threads, suite_slice, &s);
+	t = get_ms() - t;
+
+	for (i = 0; i < SUITE_POSITIONS; ++i) {
+		nps = s.r[i].ms ? 1000.0 * (double)s.r[i].nodes / (double)s.r[i].ms : 0.0;
+		printf("%2d  %-5s %10lld nodes %7lld ms %9.0f nps  %s\n", i + 1,
+				move_str(s.r[i].best), s.r[i].nodes, s.r[i].ms, nps, bench_fen[i]);
+		total += s.r[i].nodes;
+	}
+	nps = t ? 1000.0 * (double)total / (double)t : 0.0;
+	printf("\n");
+	printf("Depth %d, %d MB hash per thread, %d threads\n", depth, mb, threads);
+	printf("Time: %lld ms\n", t);
+	printf("Nodes per second: %.0f\n", nps);
+	printf("Signature: %lld\n", total);
+
+	f = fopen(SUITE_FILE, "w");
+	if (f) {
+		fprintf(f, "{\n");
+		fprintf(f, "  \"depth\": %d,\n  \"hash_mb\": %d,\n  \"threads\": %d,\n",
+				depth, mb, threads);
+		fprintf(f, "  \"positions\": [\n");
+		for (i = 0; i < SUITE_POSITIONS; ++i)
+			fprintf(f, "    { \"fen\": \"%s\", \"move\": \"%s\", \"nodes\": %lld, "
+					"\"time_ms\": %lld, \"nps\": %.0f }%s\n", bench_fen[i],
+					move_str(s.r[i].best), s.r[i].nodes, s.r[i].ms,
+					s.r[i].ms ? 1000.0 * (double)s.r[i].nodes / (double)s.r[i].ms : 0.0,
+					i < SUITE_POSITIONS - 1 ? "," : "");
+		fprintf(f, "  ],\n");
+		fprintf(f, "  \"nodes\": %lld,\n  \"time_ms\": %lld,\n  \"nps\": %.0f\n}\n",
+				total, t, nps);
+		fclose(f);
+		printf("Results written to %s.\n", SUITE_FILE);
+	}
+	open_book();
+}
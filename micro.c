@@ -0,0 +1,323 @@
+/*
+ *	MICRO.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Timing the engine's kernels one at a time
+ */
+
+
+/* microbench() is the "microbench" command. It times the functions the
+   search spends its time in (the kernels) separately, so a change to
+   board.c or eval.c can be judged by the kernel it touches rather than
+   by the search speed alone.
+
+   The kernels run over a set of positions: the positions of the "suite"
+   command and every position one legal move away from them, or the
+   positions in an EPD file. A position is set up outside the timed
+   part, then its kernel runs MICRO_REPS times. Each kernel makes one
+   pass over the positions to warm up the caches and branch predictors,
+   then MICRO_PASSES timed passes, and the fastest pass is reported in
+   nanoseconds per call, and in cycles and instructions per call when
+   the processor's counters are available (see perf.c). It all runs in a
+   thread of its own, so the board of the game in progress is left
+   alone. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+#define MICRO_REPS		50
+#define MICRO_PASSES	3
+
+/* a position of the set, as it's stored until it's set up */
+typedef struct {
+	unsigned char board[64];
+	signed char side;
+	signed char castle;
+	signed char ep;
+} micro_pos_t;
+
+/* a kernel: a function that calls it MICRO_REPS times in the current
+   position and returns the number of calls */
+typedef struct {
+	char *name;
+	int (*f)();
+} kernel_t;
+
+static micro_pos_t *micro_pos;
+static int micro_count;
+static int micro_size;
+static volatile int sink;  /* keeps the results from being optimized away */
+
+
+/* save_pos() adds the current position to the set */
+
+static BOOL save_pos()
+{
+	micro_pos_t *p;
+
+	if (micro_count == micro_size) {
+		micro_size = micro_size ? micro_size * 2 : 4096;
+		p = (micro_pos_t *)realloc(micro_pos, micro_size * sizeof(micro_pos_t));
+		if (!p)
+			return FALSE;
+		micro_pos = p;
+	}
+	p = &micro_pos[micro_count++];
+	memcpy(p->board, board, 64);
+	p->side = (signed char)side;
+	p->castle = (signed char)castle;
+	p->ep = (signed char)ep;
+	return TRUE;
+}
+
+
+/* load_pos() sets up position n of the set, with its move list
+   generated */
+
+static void load_pos(int n)
+{
+	micro_pos_t *p = &micro_pos[n];
+
+	memcpy(board, p->board, 64);
+	side = p->side;
+	xside = side ^ 1;
+	castle = p->castle;
+	ep = p->ep;
+	fifty = 0;
+	ply = 0;
+	hply = 0;
+	set_hash();
+	set_material();
+#ifdef USE_NNUE
+	nnue_reset();
+#endif
+	first_move[0] = 0;
+	gen();
+}
+
+
+/* the kernels */
+
+static int k_gen()
+{
+	int i;
+
+	for (i = 0; i < MICRO_REPS; ++i)
+		gen();
+	return MICRO_REPS;
+}
+
+static int k_gen_caps()
+{
+	int i;
+
+	for (i = 0; i < MICRO_REPS; ++i)
+		gen_caps();
+	return MICRO_REPS;
+}
+
+static int k_makemove()
+{
+	int i, j;
+
+	for (i = 0; i < MICRO_REPS; ++i)
+		for (j = first_move[0]; j < first_move[1]; ++j)
+			if (makemove(gen_move[j]))
+				takeback();
+	return MICRO_REPS * (first_move[1] - first_move[0]);
+}
+
+static int k_attack()
+{
+	int i, sq;
+
+	for (i = 0; i < MICRO_REPS; ++i)
+		for (sq = 0; sq < 64; ++sq)
+			sink += attack(sq, side);
+	return MICRO_REPS * 64;
+}
+
+static int k_in_check()
+{
+	int i;
+
+	for (i = 0; i < MICRO_REPS; ++i)
+		sink += in_check(side) + in_check(xside);
+	return MICRO_REPS * 2;
+}
+
+static int k_full_eval()
+{
+	int i;
+
+	for (i = 0; i < MICRO_REPS; ++i)
+		sink += full_eval();
+	return MICRO_REPS;
+}
+
+static int k_eval()
+{
+	int i;
+
+	for (i = 0; i < MICRO_REPS; ++i)
+		sink += eval();
+	return MICRO_REPS;
+}
+
+/* putTT() and getTT() are called for MICRO_REPS made-up keys spread
+   over the table, so they pay for the cache misses the search does */
+
+#define MICRO_KEY(i)	((HashType)(i) * 0x9E3779B97F4A7C15ULL)
+
+static int k_putTT()
+{
+	HashType h = hash;
+	int i;
+
+	for (i = 0; i < MICRO_REPS; ++i) {
+		hash = h ^ MICRO_KEY(i);
+		putTT(1, 0, gen_move[first_move[0]], -10000, 10000);
+	}
+	hash = h;
+	return MICRO_REPS;
+}
+
+static int k_getTT()
+{
+	HashType h = hash;
+	int i;
+
+	for (i = 0; i < MICRO_REPS; ++i) {
+		hash = h ^ MICRO_KEY(i);
+		sink += (getTT() != NULL);
+	}
+	hash = h;
+	return MICRO_REPS;
+}
+
+static kernel_t kernel[] = {
+	{ "gen", k_gen },
+	{ "gen_caps", k_gen_caps },
+	{ "makemove/takeback", k_makemove },
+	{ "attack", k_attack },
+	{ "in_check", k_in_check },
+	{ "full_eval", k_full_eval },
+	{ "eval", k_eval },
+	{ "putTT", k_putTT },
+	{ "getTT", k_getTT }
+};
+
+#define KERNELS ((int)(sizeof(kernel) / sizeof(kernel[0])))
+
+
+/* make_positions() fills the set with the positions of file, an EPD
+   file, or if file is NULL, the suite positions and their children */
+
+static void make_positions(char *file)
+{
+	FILE *f;
+	char line[512];
+	int i, j;
+
+	micro_count = 0;
+	if (file) {
+		f = fopen(file, "r");
+		if (!f) {
+			printf("Can't open %s.\n", file);
+			return;
+		}
+		while (fgets(line, sizeof(line), f))
+			if (set_fen(line) && !save_pos())
+				break;
+		fclose(f);
+		return;
+	}
+	for (i = 0; bench_fen[i]; ++i) {
+		set_fen(bench_fen[i]);
+		gen();
+		if (!save_pos())
+			return;
+		for (j = first_move[0]; j < first_move[1]; ++j)
+			if (makemove(gen_move[j])) {
+				save_pos();
+				takeback();
+			}
+	}
+}
+
+
+/* micro_thread() does the work of microbench() in its own thread; arg
+   is the file */
+
+static void micro_thread(int i, void *arg)
+{
+	int k, pass, n, calls;
+	long long t, best_t;
+	static int event[2] = { COUNT_CYCLES, COUNT_INSTRUCTIONS };
+	uint64 v[MAX_COUNTERS], best_c = 0, best_in = 0;
+	BOOL counters;
+
+	(void)i;
+	initPHT();
+	initEC();
+	make_positions((char *)arg);
+	if (!micro_count)
+		return;
+	counters = perf_open(event, 2);
+	printf("%d positions, %d calls per position, best of %d passes\n", micro_count,
+			MICRO_REPS, MICRO_PASSES);
+	if (!counters)
+		printf("(the processor's counters aren't available, so only times are shown)\n");
+	printf("\n");
+	printf("kernel                  ns/call  cycles/call   instr/call\n");
+	for (k = 0; k < KERNELS; ++k) {
+		best_t = -1;
+		calls = 0;
+		for (pass = 0; pass <= MICRO_PASSES; ++pass) {
+			t = 0;
+			calls = 0;
+			perf_reset();
+			for (n = 0; n < micro_count; ++n) {
+				load_pos(n);
+				perf_start();
+				t -= get_ns();
+				calls += kernel[k].f();
+				t += get_ns();
+				perf_stop();
+			}
+			perf_read(v);
+			if (pass && (best_t == -1 || t < best_t)) {  /* pass 0 warms up */
+				best_t = t;
+				best_c = v[0];
+				best_in = v[1];
+			}
+		}
+		printf("%-20s %10.1f", kernel[k].name, (double)best_t / calls);
+		if (counters)
+			printf(" %12.1f %12.1f\n", (double)best_c / calls, (double)best_in / calls);
+		else
+			printf("            -            -\n");
+	}
+	perf_close();
+	free(micro_pos);
+	micro_pos = NULL;
+	micro_size = 0;
+	micro_count = 0;
+
+	initHT();  /* putTT() filled it with made-up positions */
+}
+
+
+/* microbench() is the "microbench" command; file is an EPD file of
+   positions, or NULL for the built-in ones */
+
+void microbench(char *file)
+{
+	run_threads(1, micro_thread, file);
+}
@@ -0,0 +1,365 @@
+/*
+ *	NNUE.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Efficiently updatable neural network evaluation
+ */
+
+
+/* This is an optional replacement for the evaluation function in eval.c.
+   It reads networks in the HalfKP 2x256-32-32-1 format used by the first
+   Stockfish NNUE releases:
+
+   - the input layer has one feature for each (king square, piece, square)
+     combination, seen from each side. Only a few of them change when a
+     move is made, so the input layer's output (the "accumulator") is
+     updated incrementally instead of being recomputed.
+   - the accumulator of the side to move and the other side's are clipped
+     to 0..127 and fed through two 32-neuron layers with 8-bit weights and
+     then a single output neuron.
+
+   The accumulators are kept for every position in hist_dat. makemove()
+   calls nnue_make() to record which men changed; the accumulator itself is
+   only brought up to date when nnue_eval() needs it, starting from the
+   closest position in the history that has one. */
+
+
+#include <stdio.h>
+#include <string.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NNUE_AVX2
+#elif defined(__SSSE3__) || defined(__SSE4_1__)
+#include <tmmintrin.h>
+#define NNUE_SSSE3
+#endif
+
+
+#define NNUE_VERSION		0x7AF32F16
+#define PS_END				641  /* features per king square */
+#define WEIGHT_SCALE_BITS	6
+#define FV_SCALE			16
+#define NNUE_PAWN			208  /* the network's value of a pawn */
+#define MAX_UPDATE			8  /* refresh rather than replay more moves */
+
+
+/* the network */
+static short ft_bias[NNUE_HALF];
+static short ft_weight[NNUE_INPUTS * NNUE_HALF];
+static int l1_bias[NNUE_L1];
+static signed char l1_weight[NNUE_L1 * 2 * NNUE_HALF];
+static int l2_bias[NNUE_L2];
+static signed char l2_weight[NNUE_L2 * NNUE_L1];
+static int out_bias;
+static signed char out_weight[NNUE_L2];
+
+/* an accumulator for each position in the history, from each side's
+   point of view */
+typedef struct {
+	short v[2][NNUE_HALF];
+	int ksq[2];  /* the king square the features were computed for */
+	BOOL ok;  /* is this accumulator up to date? */
+} acc_t;
+
+static THREAD_LOCAL acc_t acc[HIST_STACK];
+
+/* the men that changed between position h - 1 and position h. A from
+   or to square of -1 means the man appeared or disappeared. */
+typedef struct {
+	int n;
+	int color[3];
+	int piece[3];
+	int from[3];
+	int to[3];
+} dirty_t;
+
+static THREAD_LOCAL dirty_t dirty[HIST_STACK];
+
+
+/* feature() returns the input index of a man of color c and type p on
+   square sq, seen from side s whose king is on k. The network numbers
+   squares from a1, and sees the board from black's side rotated. */
+
+static int feature(int s, int k, int c, int p, int sq)
+{
+	int o = (s == LIGHT) ? 56 : 7;  /* flip, or rotate */
+
+	return (sq ^ o) + 1 + (2 * p + (c != s)) * 64 + PS_END * (k ^ o);
+}
+
+static void add_feature(short *v, int f)
+{
+	int j;
+	short *w = &ft_weight[f * NNUE_HALF];
+
+	for (j = 0; j < NNUE_HALF; ++j)
+		v[j] += w[j];
+}
+
+static void sub_feature(short *v, int f)
+{
+	int j;
+	short *w = &ft_weight[f * NNUE_HALF];
+
+	for (j = 0; j < NNUE_HALF; ++j)
+		v[j] -= w[j];
+}
+
+
+/* refresh() computes side s's half of accumulator a from scratch */
+
+static void refresh(acc_t *a, int s)
+{
+	int i;
+	uint64 b;
+
+	a->ksq[s] = LSB(MAN_MASK(s, KING));
+	memcpy(a->v[s], ft_bias, sizeof(ft_bias));
+	b = OCCUPIED_MASK() & ~MAN_MASK(LIGHT, KING) & ~MAN_MASK(DARK, KING);
+	for (; b; b &= b - 1) {
+		i = LSB(b);
+		add_feature(a->v[s], feature(s, a->ksq[s], COLOR(i), PIECE(i), i));
+	}
+}
+
+
+/* update() brings the accumulator of the current position up to date.
+   Each side's half is either replayed from the closest known position
+   or, if that side's king has moved since, refreshed. */
+
+static acc_t *update()
+{
+	acc_t *a = &acc[hply];
+	int g, h, s, j;
+	BOOL fresh;
+	dirty_t *d;
+
+	if (a->ok)
+		return a;
+	for (g = hply - 1; g >= 0 && hply - g <= MAX_UPDATE; --g)
+		if (acc[g].ok)
+			break;
+	for (s = 0; s < 2; ++s) {
+		fresh = g < 0 || hply - g > MAX_UPDATE;
+		for (h = g + 1; !fresh && h <= hply; ++h)
+			for (j = 0; j < dirty[h].n; ++j)
+				if (dirty[h].piece[j] == KING && dirty[h].color[j] == s)
+					fresh = TRUE;
+		if (fresh) {
+			refresh(a, s);
+			continue;
+		}
+		memcpy(a->v[s], acc[g].v[s], sizeof(a->v[s]));
+		a->ksq[s] = acc[g].ksq[s];
+		for (h = g + 1; h <= hply; ++h) {
+			d = &dirty[h];
+			for (j = 0; j < d->n; ++j) {
+				if (d->piece[j] == KING)
+					continue;
+				if (d->from[j] != -1)
+					sub_feature(a->v[s], feature(s, a->ksq[s], d->color[j], d->piece[j], d->from[j]));
+				if (d->to[j] != -1)
+					add_feature(a->v[s], feature(s, a->ksq[s], d->color[j], d->piece[j], d->to[j]));
+			}
+		}
+	}
+	a->ok = TRUE;
+	return a;
+}
+
+
+static void add_dirty(dirty_t *d, int c, int p, int from, int to)
+{
+	d->color[d->n] = c;
+	d->piece[d->n] = p;
+	d->from[d->n] = from;
+	d->to[d->n] = to;
+	++d->n;
+}
+
+
+/* nnue_make() is called by makemove() once a legal move has been made.
+   It records the men that the move changed; the accumulator is computed
+   later, if the position is ever evaluated. */
+
+void nnue_make()
+{
+	dirty_t *d = &dirty[hply];
+	int from = MOVE_FROM(hist_dat[hply - 1].m);
+	int to = MOVE_TO(hist_dat[hply - 1].m);
+	int bits = hist_dat[hply - 1].bits;
+	int capture = hist_dat[hply - 1].capture;
+
+	acc[hply].ok = FALSE;
+	d->n = 0;
+	if (bits & 32) {
+		add_dirty(d, xside, PAWN, from, -1);
+		add_dirty(d, xside, MOVE_PROMOTE(hist_dat[hply - 1].m), -1, to);
+	}
+	else
+		add_dirty(d, xside, PIECE(to), from, to);
+	if (capture != EMPTY)
+		add_dirty(d, side, capture, to, -1);
+	if (bits & 4)
+		add_dirty(d, side, PAWN, to - pawn_push[xside], -1);
+	if (bits & 2)
+		switch (to) {
+			case G1:
+				add_dirty(d, LIGHT, ROOK, H1, F1);
+				break;
+			case C1:
+				add_dirty(d, LIGHT, ROOK, A1, D1);
+				break;
+			case G8:
+				add_dirty(d, DARK, ROOK, H8, F8);
+				break;
+			case C8:
+				add_dirty(d, DARK, ROOK, A8, D8);
+				break;
+		}
+}
+
+
+/* nnue_reset() forgets every accumulator. It has to be called when the
+   board is set up without makemove(). */
+
+void nnue_reset()
+{
+	int i;
+
+	for (i = 0; i < HIST_STACK; ++i)
+		acc[i].ok = FALSE;
+}
+
+
+/* dot() returns the dot product of n inputs (0..127) and n weights.
+   n is a multiple of 32. The products of two neighbouring pairs can't
+   overflow 16 bits, so maddubs doesn't saturate and all three versions
+   give the same result. */
+
+static int dot(const unsigned char *in, const signed char *w, int n)
+{
+	int i;
+#if defined(NNUE_AVX2)
+	__m256i sum = _mm256_setzero_si256();
+	__m256i one = _mm256_set1_epi16(1);
+	__m128i s;
+
+	for (i = 0; i < n; i += 32) {
+		__m256i p = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i *)(in + i)),
+				_mm256_loadu_si256((const __m256i *)(w + i)));
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(p, one));
+	}
+	s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+	return _mm_cvtsi128_si32(s);
+#elif defined(NNUE_SSSE3)
+	__m128i sum = _mm_setzero_si128();
+	__m128i one = _mm_set1_epi16(1);
+
+	for (i = 0; i < n; i += 16) {
+		__m128i p = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i *)(in + i)),
+				_mm_loadu_si128((const __m128i *)(w + i)));
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(p, one));
+	}
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return _mm_cvtsi128_si32(sum);
+#else
+	int r = 0;
+
+	for (i = 0; i < n; ++i)
+		r += in[i] * w[i];
+	return r;
+#endif
+}
+
+
+/* layer() computes m clipped ReLU neurons from n inputs */
+
+static void layer(const unsigned char *in, int n, const signed char *w,
+		const int *b, int m, unsigned char *out)
+{
+	int i, x;
+
+	for (i = 0; i < m; ++i) {
+		x = (b[i] + dot(in, w + i * n, n)) >> WEIGHT_SCALE_BITS;
+		out[i] = (unsigned char)(x < 0 ? 0 : (x > 127 ? 127 : x));
+	}
+}
+
+
+/* nnue_eval() returns the network's score of the current position,
+   relative to the side to move, in centipawns */
+
+int nnue_eval()
+{
+	acc_t *a = update();
+	unsigned char in[2 * NNUE_HALF];
+	unsigned char h1[NNUE_L1];
+	unsigned char h2[NNUE_L2];
+	int j, x, s;
+
+	/* the side to move's half comes first */
+	for (s = 0; s < 2; ++s)
+		for (j = 0; j < NNUE_HALF; ++j) {
+			x = a->v[s ? xside : side][j];
+			in[s * NNUE_HALF + j] = (unsigned char)(x < 0 ? 0 : (x > 127 ? 127 : x));
+		}
+	layer(in, 2 * NNUE_HALF, l1_weight, l1_bias, NNUE_L1, h1);
+	layer(h1, NNUE_L1, l2_weight, l2_bias, NNUE_L2, h2);
+	x = out_bias + dot(h2, out_weight, NNUE_L2);
+	return x / FV_SCALE * 100 / NNUE_PAWN;
+}
+
+
+static BOOL read_u32(FILE *f, unsigned int *u)
+{
+	unsigned char b[4];
+
+	if (fread(b, 1, 4, f) != 4)
+		return FALSE;
+	*u = b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned int)b[3] << 24);
+	return TRUE;
+}
+
+
+/* nnue_load() reads a network file. The weights are stored little
+   endian, like the machines this runs on, so they're read directly.
+   If the file is missing or doesn't have the expected layout, the
+   handcrafted evaluation stays in use. */
+
+BOOL nnue_load(char *path)
+{
+	FILE *f;
+	unsigned int version, hash, size;
+	BOOL ok;
+
+	f = fopen(path, "rb");
+	if (!f)
+		return FALSE;
+	ok = read_u32(f, &version) && version == NNUE_VERSION &&
+			read_u32(f, &hash) && read_u32(f, &size) &&
+			fseek(f, size, SEEK_CUR) == 0 &&
+			read_u32(f, &hash) &&
+			fread(ft_bias, sizeof(short), NNUE_HALF, f) == NNUE_HALF &&
+			fread(ft_weight, sizeof(short), NNUE_INPUTS * NNUE_HALF, f) == NNUE_INPUTS * NNUE_HALF &&
+			read_u32(f, &hash) &&
+			fread(l1_bias, sizeof(int), NNUE_L1, f) == NNUE_L1 &&
+			fread(l1_weight, 1, sizeof(l1_weight), f) == sizeof(l1_weight) &&
+			fread(l2_bias, sizeof(int), NNUE_L2, f) == NNUE_L2 &&
+			fread(l2_weight, 1, sizeof(l2_weight), f) == sizeof(l2_weight) &&
+			fread(&out_bias, sizeof(int), 1, f) == 1 &&
+			fread(out_weight, 1, sizeof(out_weight), f) == sizeof(out_weight) &&
+			fgetc(f) == EOF;
+	fclose(f);
+	nnue_loaded = ok;
+	use_nnue = ok;
+	nnue_reset();
+	return ok;
+}
@@ -0,0 +1,261 @@
+/*
+ *	PERF.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Counting processor events, and profiling the search with them
+ */
+
+
+/* On Linux, perf_event_open() gives each thread counters of events like
+   cycles, instructions, cache misses, and branch misses in user mode.
+   perf_open() opens a set of them as a group, so they're started,
+   stopped, and read together, and perf_read() returns their totals.
+   Where the counters can't be had (other systems, virtual machines that
+   don't pass them through, or a perf_event_paranoid setting that forbids
+   them), perf_open() returns FALSE and the callers only report times.
+
+   PROFILE (see defs.h) uses them to split the time of a search between
+   its subsystems: search() and quiesce() call prof_start() before they
+   call gen(), makemove(), eval(), getTT(), or sort(), and
+   prof_stop() after, and think() prints what each one cost. The counters
+   are opened when a profiled search starts and closed when it ends, so
+   the threads of "suite", "epd", etc. don't keep them. Every call
+   to prof_start() and prof_stop() reads the counters with a system call,
+   so a profiled search is a lot slower than a normal one. The
+   kernel's part isn't counted, but it does evict some of the search's
+   data from the caches, which adds to the cache misses. */
+
+
+#include <stdio.h>
+#include <string.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* the open counters of this thread: their file descriptors (the first
+   one leads the group) and how many there are */
+static THREAD_LOCAL int perf_fd[MAX_COUNTERS];
+static THREAD_LOCAL int perf_n;
+
+#ifdef __linux__
+static int perf_event(int event, int group)
+{
+	static unsigned long long config[MAX_COUNTERS] = {
+		PERF_COUNT_HW_CPU_CYCLES,
+		PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_MISSES,
+		PERF_COUNT_HW_BRANCH_MISSES
+	};
+	struct perf_event_attr a;
+
+	memset(&a, 0, sizeof(a));
+	a.type = PERF_TYPE_HARDWARE;
+	a.size = sizeof(a);
+	a.config = config[event];
+	a.disabled = (group == -1);
+	a.exclude_kernel = 1;
+	a.exclude_hv = 1;
+	a.read_format = PERF_FORMAT_GROUP;
+	return (int)syscall(__NR_perf_event_open, &a, 0, -1, group, 0);
+}
+#endif
+
+
+/* perf_open() opens counters of the n events in event[] (COUNT_CYCLES,
+   etc.) for the calling thread, stopped and at zero. It returns FALSE if
+   they aren't available. */
+
+BOOL perf_open(int *event, int n)
+{
+	perf_close();
+#ifdef __linux__
+	for (perf_n = 0; perf_n < n; ++perf_n) {
+		perf_fd[perf_n] = perf_event(event[perf_n], perf_n ? perf_fd[0] : -1);
+		if (perf_fd[perf_n] == -1) {
+			perf_close();
+			return FALSE;
+		}
+	}
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+
+/* perf_close() closes the counters */
+
+void perf_close()
+{
+#ifdef __linux__
+	int i;
+
+	for (i = 0; i < perf_n; ++i)
+		close(perf_fd[i]);
+#endif
+	perf_n = 0;
+}
+
+
+/* perf_start() and perf_stop() start and stop the counters; perf_reset()
+   sets them back to zero */
+
+void perf_start()
+{
+#ifdef __linux__
+	if (perf_n)
+		ioctl(perf_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+void perf_stop()
+{
+#ifdef __linux__
+	if (perf_n)
+		ioctl(perf_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+void perf_reset()
+{
+#ifdef __linux__
+	if (perf_n)
+		ioctl(perf_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+
+/* perf_read() puts the counts of the open counters in v[], in the order
+   they were opened in. They're 0 if the counters aren't open. */
+
+void perf_read(uint64 *v)
+{
+	int i;
+#ifdef __linux__
+	uint64 buf[MAX_COUNTERS + 1];  /* the number of counters, then their values */
+
+	if (perf_n && read(perf_fd[0], buf, (perf_n + 1) * sizeof(uint64)) ==
+			(ssize_t)((perf_n + 1) * sizeof(uint64))) {
+		for (i = 0; i < perf_n; ++i)
+			v[i] = buf[i + 1];
+		return;
+	}
+#endif
+	for (i = 0; i < MAX_COUNTERS; ++i)
+		v[i] = 0;
+}
+
+
+/* the profile of the current search: for each subsystem, the calls,
+   nanoseconds, and counts of the events in prof_event[]. The last
+   "subsystem" is the rest of the search, which prof_print() works out. */
+
+static int prof_event[3] = { COUNT_CYCLES, COUNT_CACHE_MISSES, COUNT_BRANCH_MISSES };
+static THREAD_LOCAL BOOL prof_counters;  /* are the counters open? */
+static THREAD_LOCAL long long prof_calls[PROF_SUBSYSTEMS + 1];
+static THREAD_LOCAL long long prof_ns[PROF_SUBSYSTEMS + 1];
+static THREAD_LOCAL uint64 prof_count[PROF_SUBSYSTEMS + 1][3];
+static THREAD_LOCAL long long prof_start_ns;  /* when prof_start() was called */
+static THREAD_LOCAL uint64 prof_start_count[MAX_COUNTERS];  /* ...and the counts then */
+static THREAD_LOCAL long long prof_search_ns;  /* when the search started */
+static THREAD_LOCAL uint64 prof_search_count[MAX_COUNTERS];  /* ...and the counts then */
+
+static char *prof_name[PROF_SUBSYSTEMS + 1] = {
+	"gen", "makemove", "eval", "getTT", "sort", "search"
+};
+
+
+/* prof_reset() starts the profile of a new search and opens the counters */
+
+void prof_reset()
+{
+	prof_counters = perf_open(prof_event, 3);
+	perf_start();
+	memset(prof_calls, 0, sizeof(prof_calls));
+	memset(prof_ns, 0, sizeof(prof_ns));
+	memset(prof_count, 0, sizeof(prof_count));
+	perf_read(prof_search_count);
+	prof_search_ns = get_ns();
+}
+
+
+/* prof_start() is called before a subsystem runs, and prof_stop() after,
+   which charges the time and events in between to subsystem s */
+
+void prof_start()
+{
+	perf_read(prof_start_count);
+	prof_start_ns = get_ns();
+}
+
+void prof_stop(int s)
+{
+	uint64 v[MAX_COUNTERS];
+	long long t = get_ns();
+	int i;
+
+	perf_read(v);
+	++prof_calls[s];
+	prof_ns[s] += t - prof_start_ns;
+	for (i = 0; i < 3; ++i)
+		prof_count[s][i] += v[i] - prof_start_count[i];
+}
+
+
+/* prof_print() prints the profile of the search. For xboard (output 2)
+   each line starts with "#", so that it's ignored. */
+
+void prof_print(int output)
+{
+	char *prefix = (output == 2) ? "# " : "";
+	uint64 v[MAX_COUNTERS];
+	long long ns = get_ns() - prof_search_ns;
+	int s, i;
+
+	/* the search itself is what's left after its subsystems */
+	perf_read(v);
+	prof_calls[PROF_SUBSYSTEMS] = 1;
+	prof_ns[PROF_SUBSYSTEMS] = ns;
+	for (i = 0; i < 3; ++i)
+		prof_count[PROF_SUBSYSTEMS][i] = v[i] - prof_search_count[i];
+	for (s = 0; s < PROF_SUBSYSTEMS; ++s) {
+		prof_ns[PROF_SUBSYSTEMS] -= prof_ns[s];
+		for (i = 0; i < 3; ++i)
+			prof_count[PROF_SUBSYSTEMS][i] -= prof_count[s][i];
+	}
+	printf("%s%-10s %11s %9s %6s", prefix, "subsystem", "calls", "ms", "time");
+	if (prof_counters)
+		printf(" %14s %12s %13s", "cycles", "cache misses", "branch misses");
+	printf("\n");
+	for (s = 0; s <= PROF_SUBSYSTEMS; ++s) {
+		printf("%s%-10s %11lld %9.1f %5.1f%%", prefix, prof_name[s],
+				prof_calls[s], (double)prof_ns[s] / 1000000.0,
+				ns ? 100.0 * (double)prof_ns[s] / (double)ns : 0.0);
+		if (prof_counters)
+			printf(" %14lld %12lld %13lld", prof_count[s][0], prof_count[s][1],
+					prof_count[s][2]);
+		printf("\n");
+	}
+	if (!prof_counters)
+		printf("%s(the processor's counters aren't available, so only times are shown)\n",
+				prefix);
+}
+
+
+/* prof_end() ends the profile of the search: it prints it (see
+   prof_print()) if output isn't 0, and closes the counters */
+
+void prof_end(int output)
+{
+	if (output)
+		prof_print(output);
+	perf_close();
+	prof_counters = FALSE;
+}
@@ -0,0 +1,383 @@
+/*
+ *	PGN.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Making the opening book from PGN games
+ */
+
+
+/* make_book() reads the games of a PGN file in batches of PGN_BATCH. The
+   games of a batch are split between one thread per processor, which
+   play each game's first BOOK_PLY plies on their own boards; every move
+   played becomes a book entry for the position it was played in. The
+   weight of an entry is Polyglot's: 2 if the side that played the move
+   won the game, 1 for a draw or an unknown result, and 0 for a loss, so
+   moves that only lost are never played by book_move(). The entries of
+   all the batches are merged by position and move (see merge_book() in
+   book.c) and written to BOOK_FILE.
+
+   Moves are read in standard algebraic notation by parse_san(). Comments,
+   variations, and NAGs are skipped, and a game stops counting at the
+   first move that can't be read or isn't legal. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+#define PGN_TEXT		2048  /* the movetext kept for a game; plenty for BOOK_PLY plies */
+#define PGN_BATCH		16384  /* the games read before the threads play them */
+
+/* a game as it's read from the file */
+typedef struct {
+	char text[PGN_TEXT];  /* the start of the movetext */
+	int result;  /* 2 if white won, 1 for a draw or an unknown result, 0 if black won */
+} game_t;
+
+/* a thread's share of a batch, and the entries it made */
+typedef struct {
+	int first;
+	int last;
+	BookEntry *e;
+	int n;
+	int size;
+	int bad;  /* games with a move that couldn't be read */
+	BOOL oom;  /* ran out of memory for the entries */
+} book_slice_t;
+
+static game_t *games;
+static char pgn_line[1024];  /* a line read past the end of a game */
+static BOOL pgn_pending;  /* is there one? */
+
+
+/* parse_san() returns the index in gen_move of the move s, in standard
+   algebraic notation ("Nf3", "exd5", "O-O", "e8=Q+", ...), or -1 if s
+   isn't a legal move or could be more than one. gen() has to have been
+   called for the current position. */
+
+int parse_san(char *s)
+{
+	char t[16];
+	int piece = PAWN, promote = 0, from_col = -1, from_row = -1;
+	int to, i, n = 0, found = -1;
+	move m;
+	char *p;
+
+	/* drop the capture, check, and annotation marks */
+	for (p = s; *p && n < 15; ++p)
+		if (!strchr("x+#!?=-", *p) || (*p == '-' && (s[0] == 'O' || s[0] == '0')))
+			t[n++] = *p;
+	t[n] = '\0';
+
+	if (!strcmp(t, "O-O") || !strcmp(t, "0-0") || !strcmp(t, "O-O-O") || !strcmp(t, "0-0-0")) {
+		piece = KING;
+		from_col = 4;
+		to = (side == LIGHT ? E1 : E8) + (n == 3 ? 2 : -2);
+	}
+	else {
+		if (n && strchr("NBRQK", t[0])) {
+			piece = (int)(strchr("PNBRQK", t[0]) - "PNBRQK");
+			memmove(t, t + 1, n--);
+		}
+		if (n && strchr("NBRQnbrq", t[n - 1])) {
+			promote = (int)(strchr("PNBRQK", toupper(t[n - 1])) - "PNBRQK");
+			t[--n] = '\0';
+		}
+		if (n < 2 || n > 4 || t[n - 2] < 'a' || t[n - 2] > 'h' || t[n - 1] < '1' || t[n - 1] > '8')
+			return -1;
+		to = (t[n - 2] - 'a') + 8 * ('8' - t[n - 1]);
+		for (i = 0; i < n - 2; ++i)
+			if (t[i] >= 'a' && t[i] <= 'h')
+				from_col = t[i] - 'a';
+			else if (t[i] >= '1' && t[i] <= '8')
+				from_row = '8' - t[i];
+			else
+				return -1;
+	}
+
+	for (i = first_move[0]; i < first_move[1]; ++i) {
+		m = gen_move[i];
+		if (MOVE_TO(m) != to || PIECE(MOVE_FROM(m)) != piece || MOVE_PROMOTE(m) != promote)
+			continue;
+		if ((from_col != -1 && COL(MOVE_FROM(m)) != from_col) ||
+				(from_row != -1 && ROW(MOVE_FROM(m)) != from_row))
+			continue;
+		if (!makemove(m))
+			continue;
+		takeback();
+		if (found != -1)
+			return -1;
+		found = i;
+	}
+	return found;
+}
+
+
+/* read_game() reads the next game of the PGN file f into g. It returns
+   FALSE if there are no more games. */
+
+static BOOL read_game(FILE *f, game_t *g)
+{
+	BOOL any = FALSE;  /* has any of the game been read? */
+	BOOL moves = FALSE;  /* has the movetext started? */
+	int len = 0, n;
+
+	g->text[0] = '\0';
+	g->result = 1;
+	for (;;) {
+		if (pgn_pending)
+			pgn_pending = FALSE;
+		else if (!fgets(pgn_line, sizeof(pgn_line), f))
+			break;
+		if (pgn_line[0] == '[') {
+			if (moves) {
+				pgn_pending = TRUE;  /* the next game's tags */
+				break;
+			}
+			any = TRUE;
+			if (!strncmp(pgn_line, "[Result ", 8)) {
+				if (strstr(pgn_line, "1-0"))
+					g->result = 2;
+				else if (strstr(pgn_line, "0-1"))
+					g->result = 0;
+			}
+			continue;
+		}
+		if (strspn(pgn_line, " \t\r\n") == strlen(pgn_line)) {
+			if (moves)
+				break;
+			continue;
+		}
+		any = moves = TRUE;
+		n = (int)strlen(pgn_line);
+		if (n > PGN_TEXT - 1 - len)
+			n = PGN_TEXT - 1 - len;
+		memcpy(g->text + len, pgn_line, n);
+		len += n;
+		g->text[len] = '\0';
+	}
+	return any;
+}
+
+
+/* add_entry() adds the current position and the move gen_move[m] to the
+   entries of slice s, with the weight for a game with the given result */
+
+static BOOL add_entry(book_slice_t *s, int m, int result)
+{
+	BookEntry *e;
+
+	if (s->n == s->size) {
+		s->size = s->size ? s->size * 2 : 65536;
+		e = (BookEntry *)realloc(s->e, s->size * sizeof(BookEntry));
+		if (!e)
+			return FALSE;
+		s->e = e;
+	}
+	e = &s->e[s->n++];
+	e->key = book_key();
+	e->move = (unsigned short)poly_move(gen_move[m]);
+	e->weight = (unsigned short)(side == LIGHT ? result : 2 - result);
+	e->learn = 0;
+	return TRUE;
+}
+
+
+/* play_game() plays the first BOOK_PLY plies of game g, adding an entry
+   to slice s for each move. It returns FALSE if a move couldn't be
+   read, and sets s->oom if an entry couldn't be added. */
+
+static BOOL play_game(game_t *g, book_slice_t *s)
+{
+	char tok[32];
+	char *p = g->text;
+	int n, depth, m;
+
+	init_board();
+	while (hply <= BOOK_PLY) {
+
+		/* skip spaces, comments, and variations */
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+			++p;
+		if (*p == '{') {
+			while (*p && *p != '}')
+				++p;
+			if (*p)
+				++p;
+			continue;
+		}
+		if (*p == ';') {
+			while (*p && *p != '\n')
+				++p;
+			continue;
+		}
+		if (*p == '(') {
+			for (depth = 0; *p; ++p)
+				if (*p == '(')
+					++depth;
+				else if (*p == ')' && --depth == 0) {
+					++p;
+					break;
+				}
+			continue;
+		}
+		if (!*p)
+			break;
+
+		/* the next token */
+		for (n = 0; *p && !strchr(" \t\r\n{(;)", *p); ++p)
+			if (n < 31)
+				tok[n++] = *p;
+		tok[n] = '\0';
+		if (!n) {
+			++p;
+			continue;
+		}
+		if (!strcmp(tok, "1-0") || !strcmp(tok, "0-1") || !strcmp(tok, "1/2-1/2") || !strcmp(tok, "*"))
+			break;
+		if (tok[0] == '$')
+			continue;
+
+		/* skip a move number ("12." or "12..."), which may be stuck to
+		   the move */
+		for (n = 0; tok[n] >= '0' && tok[n] <= '9'; ++n)
+			;
+		if (n && tok[n] == '.') {
+			while (tok[n] == '.')
+				++n;
+			memmove(tok, tok + n, strlen(tok + n) + 1);
+			if (!tok[0])
+				continue;
+		}
+
+		ply = 0;
+		gen();
+		m = parse_san(tok);
+		if (m == -1)
+			return FALSE;
+		if (!add_entry(s, m, g->result)) {
+			s->oom = TRUE;
+			return TRUE;
+		}
+		makemove(gen_move[m]);
+	}
+	return TRUE;
+}
+
+
+/* book_slice() is the work of thread i in make_book() */
+
+static void book_slice(int i, void *arg)
+{
+	book_slice_t *s = (book_slice_t *)arg + i;
+	int n;
+
+	for (n = s->first; n < s->last && !s->oom; ++n)
+		if (!play_game(&games[n], s))
+			++s->bad;
+}
+
+
+/* make_book() is the "makebook" command: it makes BOOK_FILE from the
+   games in the PGN file named file. If it runs out of memory, it stops
+   and leaves BOOK_FILE alone rather than write part of a book. */
+
+void make_book(char *file)
+{
+	FILE *f;
+	book_slice_t s[MAX_THREADS];
+	BookEntry *e = NULL, *e2;
+	int i, count, threads, n = 0, size = 0, merged = 0, total = 0, bad = 0;
+	BOOL nnue = use_nnue;
+	BOOL oom = FALSE;
+	long long t = get_ms();
+
+	f = fopen(file, "r");
+	if (!f) {
+		printf("Can't open %s.\n", file);
+		return;
+	}
+	games = (game_t *)malloc(PGN_BATCH * sizeof(game_t));
+	if (!games) {
+		printf("Out of memory.\n");
+		fclose(f);
+		return;
+	}
+	use_nnue = FALSE;  /* makemove() needn't update the accumulators */
+	threads = cpu_count();
+	memset(s, 0, sizeof(s));
+	pgn_pending = FALSE;
+	while (!oom) {
+		for (count = 0; count < PGN_BATCH && read_game(f, &games[count]); ++count)
+			;
+		if (!count)
+			break;
+		for (i = 0; i < threads; ++i) {
+			s[i].first = (int)((long long)count * i / threads);
+			s[i].last = (int)((long long)count * (i + 1) / threads);
+			s[i].n = 0;
+		}
+		run_threads(threads, book_slice, s);
+		total += count;
+		for (i = 0; i < threads; ++i)
+			if (s[i].oom)
+				oom = TRUE;
+
+		/* collect the threads' entries, and merge them whenever they've
+		   doubled since the last merge */
+		for (i = 0; i < threads && !oom; ++i) {
+			if (n + s[i].n > size) {
+				size = (n + s[i].n) * 2;
+				e2 = (BookEntry *)realloc(e, size * sizeof(BookEntry));
+				if (!e2) {
+					oom = TRUE;
+					continue;
+				}
+				e = e2;
+			}
+			memcpy(e + n, s[i].e, s[i].n * sizeof(BookEntry));
+			n += s[i].n;
+		}
+		if (!oom && n > 2 * merged)
+			n = merged = merge_book(e, n);
+		printf("%d games read\r", total);
+		fflush(stdout);
+	}
+	fclose(f);
+	for (i = 0; i < threads; ++i) {
+		bad += s[i].bad;
+		free(s[i].e);
+	}
+	free(games);
+	games = NULL;
+	use_nnue = nnue;
+	if (oom) {
+		free(e);
+		init_board();
+		printf("Out of memory after %d games; %s wasn't written.\n", total, BOOK_FILE);
+		return;
+	}
+
+	t = get_ms() - t;
+	printf("%d games in %lld ms (%.0f games/sec, %d threads)", total, t,
+			total * 1000.0 / (t ? t : 1), threads);
+	if (bad)
+		printf(", %d stopped at a move that couldn't be read", bad);
+	printf(".\n");
+	close_book();  /* the file is about to change under the mapping */
+	if (n) {
+		n = write_book(BOOK_FILE, e, n);
+		if (n == -1)
+			printf("Can't write %s.\n", BOOK_FILE);
+		else
+			printf("Opening book: %d entries written to %s.\n", n, BOOK_FILE);
+	}
+	free(e);
+	init_board();
+	open_book();
+}
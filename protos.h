@@ -10,26 +10,61 @@
 
 /* board.c */
 void init_board();
-void init_hash();
-HashType hash_rand();
+uint64 board_mask(int mask, int value);
+char *set_fen(char *s);
 void set_hash();
 BOOL in_check(int s);
 BOOL attack(int sq, int s);
 void gen();
 void gen_caps();
 void gen_push(int from, int to, int bits);
-void gen_promote(int from, int to, int bits);
-BOOL makemove(move_bytes m);
+void gen_promote(int from, int to);
+int move_bits(move m);
+BOOL pseudo_legal(move m);
+BOOL makemove(move m);
 void takeback();
+int tt_hashfull();
 void initHT();
 
 /* book.c */
 void open_book();
 void close_book();
+HashType book_key();
+int poly_move(move m);
 int book_move();
-BOOL book_match(char *s1, char *s2);
+int merge_book(BookEntry *e, int n);
+int write_book(char *s, BookEntry *e, int n);
+void book_from_text(char *in, char *out);
+
+/* epd.c */
+void epd(char *file, long long ms, int depth);
+
+/* pgn.c */
+int parse_san(char *s);
+void make_book(char *file);
+
+/* perf.c */
+BOOL perf_open(int *event, int n);
+void perf_close();
+void perf_start();
+void perf_stop();
+void perf_reset();
+void perf_read(uint64 *v);
+void prof_reset();
+void prof_start();
+void prof_stop(int s);
+void prof_print(int output);
+void prof_end(int output);
+
+/* trace.c */
+BOOL trace_open(char *s);
+unsigned long long trace_close();
+void trace_node(int alpha, int beta, int depth, int score, int flags,
+		unsigned long long n);
+void trace_stat(char *s);
 
 /* search.c */
+void print_latency();
 void think(int output);
 int search(int alpha, int beta, int depth);
 int quiesce(int alpha, int beta);
@@ -39,24 +74,67 @@ void sort(int from);
 void checkup();
 
 /* eval.c */
+void init_eval();
+void init_pcsq();
+#ifndef __GNUC__
+int popcount(uint64 b);
+int lsb(uint64 b);
+int msb(uint64 b);
+#endif
+void set_material();
+void eval_pawns(PawnHtTyp *pe);
+void probe_pawns();
+void initPHT();
+void initEC();
 int eval();
-int eval_light_pawn(int sq);
-int eval_dark_pawn(int sq);
+int full_eval();
+int lazy_eval(int alpha, int beta, BOOL *full);
+void eval_attacks(int score[2], uint64 occ[2], uint64 pawn_occ[2],
+		int king_sq[2], int *men, int n);
+int eval_pawn_structure(int c);
 int eval_light_king(int sq);
+int eval_light_shield(int col);
 int eval_lkp(int f);
 int eval_dark_king(int sq);
+int eval_dark_shield(int col);
 int eval_dkp(int f);
 
+/* gentables.c */
+HashType hash_rand();
+BOOL hash_keys_ok();
+void write_tables(char *s);
+
+/* micro.c */
+void microbench(char *file);
+
+/* nnue.c */
+void nnue_make();
+void nnue_reset();
+int nnue_eval();
+BOOL nnue_load(char *path);
+
+/* thread.c */
+void run_threads(int n, void (*f)(int, void *), void *arg);
+int cpu_count();
+
+/* tune.c */
+void tune(char *file);
+
 /* main.c */
 long long get_ms();
+long long get_ns();
 int main();
 int parse_move(char *s);
-char *move_str(move_bytes m);
+char *move_str(move m);
 void print_board();
 void xboard();
 void print_result();
 void bench();
+void suite(int depth, int mb, int threads);
+extern char *bench_fen[];
 extern void initHT();
 extern HtTyp *getTT();
 extern void putTT(int depth, int eval, move m, int alpha, int beta);
+extern void putTTEval(int eval);
+extern move tt_move(HtTyp *e);
 
@@ -11,12 +11,19 @@
 #include "defs.h"
 #include "data.h"
 #include "protos.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SORT_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SORT_SSE2
+#endif
 
 
 /* see the beginning of think() */
 #include <setjmp.h>
-jmp_buf env;
-BOOL stop_search;
+THREAD_LOCAL jmp_buf env;
+THREAD_LOCAL BOOL stop_search;
 
 // TO REMOVE : USE HIST_DAT STRUCT
 int lastPlayedScore = 0;
@@ -35,6 +42,126 @@ void checkLearning() // Fonction v
 
 
 
+#ifdef SEARCH_STATS
+/* print_stats() prints the search statistics after an iteration that
+   searched n nodes, when the one before searched last_n. xboard gets
+   them as a comment line, which it ignores but logs. */
+
+static void print_stats(int output, unsigned long long n, unsigned long long last_n)
+{
+	printf(output == 2 ? "# " : "     ");
+	printf("seldepth %d, qnodes %.1f%%, ebf %.2f, hash hits %.1f%%, cutoffs %lld, "
+			"stores %lld, overwrites %lld, hashfull %d, first move cutoffs %.1f%%\n",
+			sel_depth, nodes ? 100.0 * (double)q_nodes / (double)nodes : 0.0,
+			last_n ? (double)n / (double)last_n : 0.0,
+			tt_probes ? 100.0 * (double)tt_hits / (double)tt_probes : 0.0,
+			tt_cutoffs, tt_stores, tt_overwrites, tt_hashfull(),
+			beta_cutoffs ? 100.0 * (double)first_cutoffs / (double)beta_cutoffs : 0.0);
+}
+#endif
+
+
+/* The timing of the searches think() does with a time limit: how far
+   past the limit they went (the overshoot), how long checkup() took to
+   notice it was up (the lag), and how long think() took to return after
+   that (the unwind). Each is counted in buckets of powers of 2
+   microseconds: bucket 0 is under 1 us, bucket i is from 2^(i-1) to
+   2^i us, and the last bucket holds everything longer. */
+
+#define LATENCY_BUCKETS 24
+
+static THREAD_LOCAL unsigned long long timed_searches;
+static THREAD_LOCAL unsigned long long stopped_searches;  /* ...stopped by the time limit */
+static THREAD_LOCAL long long allotted_ns;  /* their time limits, added up */
+static THREAD_LOCAL long long used_ns;  /* ...and the time they took */
+static THREAD_LOCAL long long worst_ns;  /* the biggest overshoot */
+static THREAD_LOCAL unsigned long long overshoot[LATENCY_BUCKETS];
+static THREAD_LOCAL unsigned long long lag[LATENCY_BUCKETS];
+static THREAD_LOCAL unsigned long long unwind[LATENCY_BUCKETS];
+static THREAD_LOCAL long long start_ns;  /* when the search started */
+static THREAD_LOCAL long long abort_ns;  /* when checkup() stopped it */
+
+/* checkup() reads the clock every poll_interval nodes; poll_ns and
+   poll_nodes are the time and node count of its last call */
+static THREAD_LOCAL unsigned long long poll_interval = 1024;
+static THREAD_LOCAL long long poll_ns;
+static THREAD_LOCAL unsigned long long poll_nodes;
+
+
+/* latency_bucket() returns the bucket of ns nanoseconds */
+
+static int latency_bucket(long long ns)
+{
+	long long us = ns / 1000;
+	int i = 0;
+
+	while (us > 0 && i < LATENCY_BUCKETS - 1) {
+		us >>= 1;
+		++i;
+	}
+	return i;
+}
+
+
+/* record_latency() adds the search think() is returning from to the
+   timing, if it had a time limit. stopped is TRUE if checkup() stopped
+   it. */
+
+static void record_latency(BOOL stopped)
+{
+	long long t = get_ns();
+
+	if (max_time >= (1 << 25))  /* no time limit */
+		return;
+	++timed_searches;
+	allotted_ns += max_time * 1000000;
+	used_ns += t - start_ns;
+	if (t > stop_ns) {
+		++overshoot[latency_bucket(t - stop_ns)];
+		if (t - stop_ns > worst_ns)
+			worst_ns = t - stop_ns;
+	}
+	if (stopped && abort_ns >= stop_ns) {
+		++stopped_searches;
+		++lag[latency_bucket(abort_ns - stop_ns)];
+		++unwind[latency_bucket(t - abort_ns)];
+	}
+}
+
+
+/* print_latency() is the "latency" command: it prints the timing of the
+   searches with a time limit as histograms */
+
+void print_latency()
+{
+	unsigned long long late = 0;
+	char s[32];
+	int i, n;
+
+	for (i = 0; i < LATENCY_BUCKETS; ++i)
+		late += overshoot[i];
+	printf("%llu searches with a time limit, %llu stopped by it, %llu past it\n",
+			timed_searches, stopped_searches, late);
+	if (!timed_searches)
+		return;
+	printf("time allotted %.3f s, used %.3f s, worst overshoot %.3f ms\n",
+			(double)allotted_ns / 1e9, (double)used_ns / 1e9, (double)worst_ns / 1e6);
+	for (n = LATENCY_BUCKETS; n > 1 && !overshoot[n - 1] && !lag[n - 1] && !unwind[n - 1]; --n)
+		;
+	printf("\n");
+	printf("microseconds     overshoot        lag     unwind\n");
+	for (i = 0; i < n; ++i) {
+		if (i == 0)
+			sprintf(s, "< 1");
+		else if (i == LATENCY_BUCKETS - 1)
+			sprintf(s, ">= %lld", 1LL << (i - 1));
+		else
+			sprintf(s, "%lld-%lld", 1LL << (i - 1), 1LL << i);
+		printf("%-16s %9llu %10llu %10llu\n", s, overshoot[i], lag[i], unwind[i]);
+	}
+}
+
+
 /* think() calls search() iteratively. Search statistics
    are printed depending on the value of output:
    0 = no output
@@ -44,11 +171,21 @@ void checkLearning() // Fonction v
 void think(int output)
 {
 	int i, j, x;
+#ifdef SEARCH_STATS
+	/* the nodes of this iteration and the last; volatile, since they're
+	   set after the setjmp() */
+	volatile unsigned long long n, last_n = 0;
+#endif
 
-	/* try the opening book first */
-	pv[0][0].u = book_move();
-	if (pv[0][0].u != -1)
-		return;
+	/* try the opening book first, unless the search has to be
+	   repeatable */
+	if (!deterministic) {
+		x = book_move();
+		if (x != -1) {
+			pv[0][0] = (move)x;
+			return;
+		}
+	}
 
 	/* some code that lets us longjmp back here and return
 	   from think() when our time is up */
@@ -59,22 +196,69 @@ void think(int output)
 		/* make sure to take back the line we were searching */
 		while (ply)
 			takeback();
+		record_latency(TRUE);
+#ifdef PROFILE
+		prof_end(output);
+#endif
 		return;
 	}
 
-	start_time = get_ms();
-	stop_time = start_time + max_time;
+	/* a repeatable search starts from empty tables, so it doesn't
+	   depend on the searches before it */
+	if (deterministic) {
+		initHT();
+		initPHT();
+		initEC();
+		tt_age = 0;
+	}
+
+	start_ns = get_ns();
+	start_time = start_ns / 1000000;
+	stop_ns = start_ns + max_time * 1000000;
+	poll_ns = start_ns;
+	poll_nodes = 0;
 
 	ply = 0;
 	nodes = 0;
+	check_nodes = 0;
+	iterations = 0;
+	evals = 0;
+	pawn_probes = 0;
+	pawn_hits = 0;
+	tt_probes = 0;
+	tt_hits = 0;
+	tt_bad_moves = 0;
+	tt_collisions = 0;
+	eval_hits = 0;
+	tt_evals = 0;
+	lazy_tries = 0;
+	lazy_exits = 0;
+	lazy_wrong = 0;
+	lazy_error = 0;
+	q_nodes = 0;
+	tt_cutoffs = 0;
+	tt_stores = 0;
+	tt_overwrites = 0;
+	beta_cutoffs = 0;
+	first_cutoffs = 0;
+	sel_depth = 0;
+#ifdef PROFILE
+	prof_reset();
+#endif
 
 	memset(pv, 0, sizeof(pv));
 	memset(history, 0, sizeof(history));
-	initHT();
+
+	/* the hash table is kept from one search to the next, but the
+	   entries of earlier searches are the first to be replaced */
+	tt_age = (unsigned char)(tt_age + AGE_STEP);
 	if (output == 1)
 		printf("ply      nodes  score  time pv\n");
 	for (i = 1; i <= max_depth; ++i) {
 		follow_pv = TRUE;
+#ifdef SEARCH_STATS
+		n = nodes;
+#endif
 		x = search(-10000, 10000, i);
 		if (output == 1)
 			printf("%3d  %9lld  %5d %10.3f", i, nodes, x, (float)(get_ms() - start_time)/1000.0);
@@ -83,31 +267,85 @@ void think(int output)
 					i, x, (get_ms() - start_time) / 10, nodes);
 		if (output) {
 			for (j = 0; j < pv_length[0]; ++j)
-				printf(" %s", move_str(pv[0][j].b));
+				printf(" %s", move_str(pv[0][j]));
 			printf("\n");
+#ifdef SEARCH_STATS
+			n = nodes - n;
+			print_stats(output, n, last_n);
+			last_n = n;
+#endif
 			fflush(stdout);
 		}
+		if (iterations < MAX_PLY) {
+			iter_move[iterations] = pv[0][0];
+			iter_ms[iterations] = get_ms() - start_time;
+			++iterations;
+		}
 		if (x > 9000 || x < -9000)
 			break;
 	}
+	record_latency(FALSE);
+#ifdef PROFILE
+	prof_end(output);
+#endif
 }
 
 
-/* search() does just that, in negamax fashion */
+#ifdef TRACE
+/* With TRACE, search() and quiesce() call search_node() and
+   quiesce_node(), which do the searching, and write a record of the
+   node to the trace when they return (see trace.c). */
+
+static int search_node(int alpha, int beta, int depth);
+static int quiesce_node(int alpha, int beta);
 
 int search(int alpha, int beta, int depth)
+{
+	unsigned long long n = nodes;
+	int x;
+
+	if (!trace_on || !depth)  /* quiesce() writes its own record */
+		return search_node(alpha, beta, depth);
+	trace_cut[ply] = TRACE_NONE;
+	x = search_node(alpha, beta, depth);
+	trace_node(alpha, beta, depth, x, 0, nodes - n);
+	return x;
+}
+
+int quiesce(int alpha, int beta)
+{
+	unsigned long long n = nodes;
+	int x;
+
+	if (!trace_on)
+		return quiesce_node(alpha, beta);
+	trace_cut[ply] = TRACE_NONE;
+	x = quiesce_node(alpha, beta);
+	trace_node(alpha, beta, 0, x, TRACE_QUIESCE, nodes - n);
+	return x;
+}
+#else
+#define search_node search
+#define quiesce_node quiesce
+#endif
+
+
+/* search() does just that, in negamax fashion */
+
+int search_node(int alpha, int beta, int depth)
 {
 	int i, j, x;
-	BOOL c, f;
+	BOOL c, f, legal;
 
 	/* we're as deep as we want to be; call quiesce() to get
 	   a reasonable score and return it. */
 	if (!depth)
 		return quiesce(alpha,beta);
 	++nodes;
+	STATS(if (ply > sel_depth) sel_depth = ply);
 
-	/* do some housekeeping every 1024 nodes */
-	if ((nodes & 1023) == 0)
+	/* do some housekeeping every so often (see checkup()) */
+	if (nodes >= check_nodes)
 		checkup();
 
 	pv_length[ply] = ply;
@@ -131,11 +369,16 @@ int search(int alpha, int beta, int depth)
 		++depth;
 #ifdef USE_HASH
 	move transpositionMove;
-	transpositionMove.u= 0;
+	transpositionMove= 0;
+	PROFILE_START();
 	HtTyp *pTransp = getTT();
+	PROFILE_STOP(PROF_TT);
 	if (pTransp)
 	{
-		transpositionMove = pTransp->move;
+		/* the entry may come from another position with the same
+		   index and key, so its move is only trusted if it could
+		   have been generated here */
+		transpositionMove = tt_move(pTransp);
 		int pTranspEval = pTransp->score;
 		UNSCALE_MATE_VALUE(pTranspEval);
 
@@ -143,8 +386,11 @@ int search(int alpha, int beta, int depth)
 		{
 			if (pTransp->flag & FLAG_VALID)
 			{
-				pv_length[ply] = ply + 1;
-				pv[ply][ply] = pTransp->move;
+				if (transpositionMove) {
+					pv_length[ply] = ply + 1;
+					pv[ply][ply] = transpositionMove;
+				}
+				STATS(++tt_cutoffs);
 				return pTranspEval;
 			}
 			else
@@ -161,54 +407,123 @@ int search(int alpha, int beta, int depth)
 					}
 			if (alpha >= beta)
 			{
-				pv_length[ply] = ply + 1;
-				pv[ply][ply] = pTransp->move;
+				if (transpositionMove) {
+					pv_length[ply] = ply + 1;
+					pv[ply][ply] = transpositionMove;
+				}
+				STATS(++tt_cutoffs);
 				return alpha;
 			}
 		}
 	}
-#endif
-	gen();
-	if (follow_pv)  /* are we following the PV? */
-		sort_pv(pv[0][ply]);
-#ifdef USE_HASH
-#if 1
-	// Rordonnancement des coups: on joue le meilleur coup de la hash table
-	else if (transpositionMove.u != 0)
+#ifdef USE_IID
+	/* internal iterative deepening: without a hash move this node
+	   would only be ordered by captures and history, so run a
+	   shallower search first and use the move it finds */
+	if (!follow_pv && !transpositionMove && !c && depth >= IID_DEPTH)
 	{
-		// Hack pour que le coup de la hash table soit choisi en premier
-		sort_pv(transpositionMove);
+		search(alpha, beta, depth - IID_REDUCTION);
+		PROFILE_START();
+		pTransp = getTT();
+		PROFILE_STOP(PROF_TT);
+		if (pTransp)
+			transpositionMove = tt_move(pTransp);
+		if (!transpositionMove && pv_length[ply] > ply)
+			transpositionMove = pv[ply][ply];
+		pv_length[ply] = ply;
+		TRACE_CUT(TRACE_NONE);  /* that search's cutoff isn't this node's */
 	}
 #endif
 #endif
 	f = FALSE;
 	move bestmove;
-	bestmove.u = 0;          // Pas de meilleur coup pour le moment
+	bestmove = 0;          // Pas de meilleur coup pour le moment
 	int searchAlpha = alpha; // borne alpha initiale
+	int searched = 0;  /* the moves searched so far */
+
+#ifdef USE_HASH
+	/* search the hash move before generating anything else. It has
+	   passed pseudo_legal(), so it can be played without a move list;
+	   when it causes a cutoff, gen() is never called at this node. */
+	if (!follow_pv && transpositionMove != 0)
+	{
+		first_move[ply + 1] = first_move[ply];
+		PROFILE_START();
+		legal = makemove(transpositionMove);
+		PROFILE_STOP(PROF_MAKE);
+		if (legal) {
+			f = TRUE;
+			++searched;
+			x = -search(-beta, -alpha, depth - 1);
+			PROFILE_START();
+			takeback();
+			PROFILE_STOP(PROF_MAKE);
+			if (x > alpha) {
+				bestmove = transpositionMove;
+				if (!stop_search) putTT(depth, x, bestmove, alpha, beta);
+				history[MOVE_FROM(transpositionMove)][MOVE_TO(transpositionMove)] += depth;
+				if (x >= beta) {
+					STATS(++beta_cutoffs);
+					STATS(++first_cutoffs);
+					TRACE_CUT(0);
+					return beta;
+				}
+				alpha = x;
+				pv[ply][ply] = transpositionMove;
+				for (j = ply + 1; j < pv_length[ply + 1]; ++j)
+					pv[ply][j] = pv[ply + 1][j];
+				pv_length[ply] = pv_length[ply + 1];
+			}
+		}
+	}
+	else
+		transpositionMove = 0;
+#endif
+	PROFILE_START();
+	gen();
+	PROFILE_STOP(PROF_GEN);
+	if (follow_pv)  /* are we following the PV? */
+		sort_pv(pv[0][ply]);
 
 	/* loop through the moves */
 	for (i = first_move[ply]; i < first_move[ply + 1]; ++i) {
+		PROFILE_START();
 		sort(i);
-		if (!makemove(gen_dat[i].m.b))
+		PROFILE_STOP(PROF_SORT);
+#ifdef USE_HASH
+		if (gen_move[i] == transpositionMove)
+			continue;  /* already searched above */
+#endif
+		PROFILE_START();
+		legal = makemove(gen_move[i]);
+		PROFILE_STOP(PROF_MAKE);
+		if (!legal)
 			continue;
 		f = TRUE;
+		++searched;
 		x = -search(-beta, -alpha, depth - 1);
+		PROFILE_START();
 		takeback();
+		PROFILE_STOP(PROF_MAKE);
 		if (x > alpha) {
-			bestmove = gen_dat[i].m;
+			bestmove = gen_move[i];
 #ifdef USE_HASH
 			if (!stop_search) putTT(depth , x, bestmove, alpha, beta);
 #endif
 			/* this move caused a cutoff, so increase the history
 			   value so it gets ordered high next time we can
 			   search it */
-			history[(int)gen_dat[i].m.b.from][(int)gen_dat[i].m.b.to] += depth;
-			if (x >= beta)
+			history[MOVE_FROM(gen_move[i])][MOVE_TO(gen_move[i])] += depth;
+			if (x >= beta) {
+				STATS(++beta_cutoffs);
+				STATS(if (searched == 1) ++first_cutoffs);
+				TRACE_CUT(searched - 1);
 				return beta;
+			}
 			alpha = x;
 
 			/* update the PV */
-			pv[ply][ply] = gen_dat[i].m;
+			pv[ply][ply] = gen_move[i];
 			for (j = ply + 1; j < pv_length[ply + 1]; ++j)
 				pv[ply][j] = pv[ply + 1][j];
 			pv_length[ply] = pv_length[ply + 1];
@@ -251,14 +566,19 @@ int search(int alpha, int beta, int depth)
    is to find a position where there isn't a lot going on
    so the static evaluation function will work. */
 
-int quiesce(int alpha,int beta)
+int quiesce_node(int alpha,int beta)
 {
 	int i, j, x;
+	move m;
+	BOOL legal;
+	int searched = 0;  /* the moves searched so far */
 
 	++nodes;
+	STATS(++q_nodes);
+	STATS(if (ply > sel_depth) sel_depth = ply);
 
-	/* do some housekeeping every 1024 nodes */
-	if ((nodes & 1023) == 0)
+	/* do some housekeeping every so often (see checkup()) */
+	if (nodes >= check_nodes)
 		checkup();
 
 	pv_length[ply] = ply;
@@ -270,7 +590,9 @@ int quiesce(int alpha,int beta)
 		return eval();
 
 #ifdef USE_HASH
+	PROFILE_START();
 	HtTyp *pTransp = getTT();
+	PROFILE_STOP(PROF_TT);
 	if (pTransp)
 	{
 		int pTranspEval = pTransp->score;
@@ -278,8 +600,11 @@ int quiesce(int alpha,int beta)
 
 		if (pTransp->flag & FLAG_VALID)
 		{
-			pv_length[ply] = ply + 1;
-			pv[ply][ply] = pTransp->move;
+			if ((m = tt_move(pTransp)) != 0) {
+				pv_length[ply] = ply + 1;
+				pv[ply][ply] = m;
+			}
+			STATS(++tt_cutoffs);
 			return pTranspEval;
 		}
 		else
@@ -296,37 +621,78 @@ int quiesce(int alpha,int beta)
 				}
 		if (alpha >= beta)
 		{
-			pv_length[ply] = ply + 1;
-			pv[ply][ply] = pTransp->move;
+			if ((m = tt_move(pTransp)) != 0) {
+				pv_length[ply] = ply + 1;
+				pv[ply][ply] = m;
+			}
+			STATS(++tt_cutoffs);
 			return alpha;
 		}
 	}
 #endif
-	/* check with the evaluation function */
+	/* check with the evaluation function, unless the hash table
+	   already knows what it returns for this position */
+#ifdef USE_HASH
+	if (pTransp && (pTransp->flag & FLAG_EVAL)) {
+		x = pTransp->eval;
+		++tt_evals;
+	}
+	else {
+#ifdef USE_LAZY_EVAL
+		BOOL full;
+
+		PROFILE_START();
+		x = lazy_eval(alpha, beta, &full);
+		PROFILE_STOP(PROF_EVAL);
+		if (full)
+			putTTEval(x);
+#else
+		PROFILE_START();
+		x = eval();
+		PROFILE_STOP(PROF_EVAL);
+		putTTEval(x);
+#endif
+	}
+#else
+	PROFILE_START();
 	x = eval();
+	PROFILE_STOP(PROF_EVAL);
+#endif
 	if (x >= beta)
 		return beta;
 	if (x > alpha)
 		alpha = x;
 
+	PROFILE_START();
 	gen_caps();
+	PROFILE_STOP(PROF_GEN);
 	if (follow_pv)  /* are we following the PV? */
 		sort_pv(pv[0][ply]);
 
 	/* loop through the moves */
 	for (i = first_move[ply]; i < first_move[ply + 1]; ++i) {
+		PROFILE_START();
 		sort(i);
-		if (!makemove(gen_dat[i].m.b))
+		PROFILE_STOP(PROF_SORT);
+		PROFILE_START();
+		legal = makemove(gen_move[i]);
+		PROFILE_STOP(PROF_MAKE);
+		if (!legal)
 			continue;
+		++searched;
 		x = -quiesce(-beta, -alpha);
+		PROFILE_START();
 		takeback();
+		PROFILE_STOP(PROF_MAKE);
 		if (x > alpha) {
-			if (x >= beta)
+			if (x >= beta) {
+				TRACE_CUT(searched - 1);
 				return beta;
+			}
 			alpha = x;
 
 			/* update the PV */
-			pv[ply][ply] = gen_dat[i].m;
+			pv[ply][ply] = gen_move[i];
 			for (j = ply + 1; j < pv_length[ply + 1]; ++j)
 				pv[ply][j] = pv[ply + 1][j];
 			pv_length[ply] = pv_length[ply + 1];
@@ -338,14 +704,16 @@ int quiesce(int alpha,int beta)
 
 /* reps() returns the number of times the current position
    has been repeated. It compares the current value of hash
-   to previous values. */
+   to previous values. After set_fen(), fifty can count moves
+   that aren't in hist_dat[], so only the ones that are get
+   looked at. */
 
 int reps()
 {
 	int i;
 	int r = 0;
 
-	for (i = hply - fifty; i < hply; ++i)
+	for (i = (hply > fifty) ? hply - fifty : 0; i < hply; ++i)
 		if (hist_dat[i].hash == hash)
 			++r;
 	return r;
@@ -365,9 +733,9 @@ void sort_pv(move m)
 
 	follow_pv = FALSE;
 	for(i = first_move[ply]; i < first_move[ply + 1]; ++i)
-		if (gen_dat[i].m.u == m.u) {
+		if (gen_move[i] == m) {
 			follow_pv = TRUE;
-			gen_dat[i].score += 10000000;
+			gen_score[i] += 10000000;
 			return;
 		}
 }
@@ -377,36 +745,103 @@ void sort_pv(move m)
    to the end to find the move with the highest score. Then it
    swaps that move and the 'from' move so the move with the
    highest score gets searched next, and hopefully produces
-   a cutoff. */
+   a cutoff.
+   The highest score is found 8 (AVX2) or 4 (SSE2) scores at a
+   time, then the first move that has it is picked, which is the
+   one a plain scan would pick. */
 
 void sort(int from)
 {
-	int i;
-	int bs;  /* best score */
+	int i = from;
+	int n = first_move[ply + 1];
+	int bs = -1;  /* best score */
 	int bi;  /* best i */
-	gen_t g;
-
-	bs = -1;
-	bi = from;
-	for (i = from; i < first_move[ply + 1]; ++i)
-		if (gen_dat[i].score > bs) {
-			bs = gen_dat[i].score;
-			bi = i;
+	int s;
+	move m;
+
+#if defined(SORT_AVX2)
+	if (n - i >= 8) {
+		__m256i b8 = _mm256_set1_epi32(-1);
+		__m128i b4;
+
+		for (; i + 8 <= n; i += 8)
+			b8 = _mm256_max_epi32(b8,
+					_mm256_loadu_si256((const __m256i *)&gen_score[i]));
+		b4 = _mm_max_epi32(_mm256_castsi256_si128(b8),
+				_mm256_extracti128_si256(b8, 1));
+		b4 = _mm_max_epi32(b4, _mm_shuffle_epi32(b4, _MM_SHUFFLE(1, 0, 3, 2)));
+		b4 = _mm_max_epi32(b4, _mm_shuffle_epi32(b4, _MM_SHUFFLE(2, 3, 0, 1)));
+		bs = _mm_cvtsi128_si32(b4);
+	}
+#elif defined(SORT_SSE2)
+	if (n - i >= 4) {
+		__m128i b4 = _mm_set1_epi32(-1);
+		__m128i x, gt;
+
+		/* SSE2 has no _mm_max_epi32(), so it's a compare and a blend */
+		for (; i + 4 <= n; i += 4) {
+			x = _mm_loadu_si128((const __m128i *)&gen_score[i]);
+			gt = _mm_cmpgt_epi32(x, b4);
+			b4 = _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, b4));
 		}
-	g = gen_dat[from];
-	gen_dat[from] = gen_dat[bi];
-	gen_dat[bi] = g;
+		x = _mm_shuffle_epi32(b4, _MM_SHUFFLE(1, 0, 3, 2));
+		gt = _mm_cmpgt_epi32(x, b4);
+		b4 = _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, b4));
+		x = _mm_shuffle_epi32(b4, _MM_SHUFFLE(2, 3, 0, 1));
+		gt = _mm_cmpgt_epi32(x, b4);
+		b4 = _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, b4));
+		bs = _mm_cvtsi128_si32(b4);
+	}
+#endif
+	for (; i < n; ++i)
+		if (gen_score[i] > bs)
+			bs = gen_score[i];
+	bi = from;
+	if (bs > -1)
+		while (gen_score[bi] != bs)
+			++bi;
+
+	m = gen_move[from];
+	gen_move[from] = gen_move[bi];
+	gen_move[bi] = m;
+	s = gen_score[from];
+	gen_score[from] = gen_score[bi];
+	gen_score[bi] = s;
 }
 
 
-/* checkup() is called once in a while during the search. */
+/* checkup() is called once in a while during the search: about every
+   POLL_NS nanoseconds, however fast the search is going. */
 
 void checkup()
 {
-	/* is the engine's time up? if so, longjmp back to the
-	   beginning of think() */
-	if (get_ms() >= stop_time) {
+	long long t = get_ns();
+	unsigned long long n;
+
+	/* is the engine's time up, or has it searched max_nodes? if so,
+	   longjmp back to the beginning of think() */
+	if ((max_nodes && nodes >= max_nodes) || t >= stop_ns) {
+		abort_ns = t;
 		stop_search = TRUE;
 		longjmp(env, 0);
 	}
+
+	/* pick the nodes until the next checkup from the speed since the
+	   last one, averaged with the last pick so one slow stretch doesn't
+	   throw it off */
+	if (nodes - poll_nodes >= POLL_MIN && t > poll_ns) {
+		n = (nodes - poll_nodes) * POLL_NS / (unsigned long long)(t - poll_ns);
+		poll_interval = (poll_interval + n) / 2;
+		if (poll_interval < POLL_MIN)
+			poll_interval = POLL_MIN;
+		if (poll_interval > POLL_MAX)
+			poll_interval = POLL_MAX;
+	}
+	poll_ns = t;
+	poll_nodes = nodes;
+
+	/* a node limit is exact */
+	check_nodes = nodes + poll_interval;
+	if (max_nodes && check_nodes > max_nodes)
+		check_nodes = max_nodes;
 }
@@ -0,0 +1,585 @@
+/*
+ *	TABLES.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Constant tables, written by the "tables" command; see gentables.c
+ */
+
+
+#include "defs.h"
+
+/* random numbers used to compute hash; see set_hash() in board.c */
+const HashType hash_piece[2][6][64] = {
+	{
+		{
+			0xE220A8397B1DCDAFULL, 0x6E789E6AA1B965F4ULL, 0x06C45D188009454FULL, 0xF88BB8A8724C81ECULL,
+			0x1B39896A51A8749BULL, 0x53CB9F0C747EA2EAULL, 0x2C829ABE1F4532E1ULL, 0xC584133AC916AB3CULL,
+			0x3EE5789041C98AC3ULL, 0xF3B8488C368CB0A6ULL, 0x657EECDD3CB13D09ULL, 0xC2D326E0055BDEF6ULL,
+			0x8621A03FE0BBDB7BULL, 0x8E1F7555983AA92FULL, 0xB54E0F1600CC4D19ULL, 0x84BB3F97971D80ABULL,
+			0x7D29825C75521255ULL, 0xC3CF17102B7F7F86ULL, 0x3466E9A083914F64ULL, 0xD81A8D2B5A4485ACULL,
+			0xDB01602B100B9ED7ULL, 0xA9038A921825F10DULL, 0xEDF5F1D90DCA2F6AULL, 0x54496AD67BD2634CULL,
+			0xDD7C01D4F5407269ULL, 0x935E82F1DB4C4F7BULL, 0x69B82EBC92233300ULL, 0x40D29EB57DE1D510ULL,
+			0xA2F09DABB45C6316ULL, 0xEE521D7A0F4D3872ULL, 0xF16952EE72F3454FULL, 0x377D35DEA8E40225ULL,
+			0x0C7DE8064963BAB0ULL, 0x05582D37111AC529ULL, 0xD254741F599DC6F7ULL, 0x69630F7593D108C3ULL,
+			0x417EF96181DAA383ULL, 0x3C3C41A3B43343A1ULL, 0x6E19905DCBE531DFULL, 0x4FA9FA7324851729ULL,
+			0x84EB4454A792922AULL, 0x134F7096918175CEULL, 0x07DC930B302278A8ULL, 0x12C015A97019E937ULL,
+			0xCC06C31652EBF438ULL, 0xECEE65630A691E37ULL, 0x3E84ECB1763E79ADULL, 0x690ED476743AAE49ULL,
+			0x774615D7B1A1F2E1ULL, 0x22B353F04F4F52DAULL, 0xE3DDD86BA71A5EB1ULL, 0xDF268ADEB6513356ULL,
+			0x2098EB73D4367D77ULL, 0x03D6845323CE3C71ULL, 0xC952C5620043C714ULL, 0x9B196BCA844F1705ULL,
+			0x30260345DD9E0EC1ULL, 0xCF448A5882BB9698ULL, 0xF4A578DCCBC87656ULL, 0xBFDEAED9A17B3C8FULL,
+			0xED79402D1D5C5D7BULL, 0x55F070AB1CBBF170ULL, 0x3E00A34929A88F1DULL, 0xE255B237B8BB18FBULL
+		},
+		{
+			0x2A7B67AF6C6AD50EULL, 0x466D5E7F3E46F143ULL, 0x42375CB399A4FC72ULL, 0x8C8A1F148A8BB259ULL,
+			0x32FCAB5DAED5BDFCULL, 0x9E60398C8D8553C0ULL, 0xEE89CCEB8C4064C0ULL, 0xDB0215941D86A66FULL,
+			0x5CCDE78203C367A8ULL, 0xF1BCBC6A1EC11786ULL, 0xEF054FCEEE954551ULL, 0xDF82012D0555C6DFULL,
+			0x292566FF72403C08ULL, 0xC4DD302A1BFA1137ULL, 0xD85F219DB5C554E1ULL, 0x6A27FF807441BCD2ULL,
+			0x96A573E9B48216E8ULL, 0x46A9FDAC40BF0048ULL, 0x3DD12464A0EE15B4ULL, 0x451E521296A7EEA1ULL,
+			0x56E4398A98F8A0FDULL, 0x7B7DC2160E3335A7ULL, 0xC679EE0BEBCB1CCAULL, 0x928D6F2D7453424EULL,
+			0x1B38994205234C6DULL, 0x8086D193A6F2B568ULL, 0x21C6E26639AC2C65ULL, 0xD9DCCAC414D23C6FULL,
+			0x91CD642057E00235ULL, 0x77FC607DC6589373ULL, 0x05B8ABE26DD3AEE7ULL, 0x12F6436AC376CC66ULL,
+			0x64952424897B2307ULL, 0xEE8C2BAF6343E5C3ULL, 0xDC4C613D9EBA2304ULL, 0x3505B7796BD1A506ULL,
+			0x8176DAF800A05F50ULL, 0x8BD8FF7A0385CDBCULL, 0x1A764A3CD78101DAULL, 0xBE4D15BF6CA266ACULL,
+			0xA85E1F38BB2DC749ULL, 0x56759A968493CD8CULL, 0xF3A9BCE7336BD182ULL, 0x365B15013741519BULL,
+			0x1F7A44A6B109AC94ULL, 0x3521D628813CB177ULL, 0x6A77AFAB0F7C9370ULL, 0x179642D8CDE95015ULL,
+			0x5EF102A8FB354461ULL, 0xF51C504764ED82F2ULL, 0xC58427F041CE6808ULL, 0xFAD8FC45C9643C37ULL,
+			0xCF8682F9A70FA9C0ULL, 0x7E1B3B75A4005729ULL, 0x992DD867927B52D8ULL, 0x7FBD5DB142F6791FULL,
+			0x370595AACAB4ADAEULL, 0xB1392DBDC5AB61D6ULL, 0x9FEA7DFC79D452D9ULL, 0x40B12B120085641CULL,
+			0xA192AFE3157C85D0ULL, 0xC847729F4E08F3A3ULL, 0x6F1384A306C41FC2ULL, 0x12D05C4045A39C19ULL
+		},
+		{
+			0x9899202FD20F0841ULL, 0xE9C7191857E774B8ULL, 0x4EEAD809AF5B0CC3ULL, 0xE809ACAFA23864A4ULL,
+			0x4DA1EDABA1D0F7BDULL, 0x846EB9673349F8E4ULL, 0x87BAE55B86039FE8ULL, 0x7F367B8BD953EFF2ULL,
+			0x3884700F650D04E1ULL, 0xBFE4B2AB46980CADULL, 0xC5FC89075299106CULL, 0x37B2FA361ADEA7CDULL,
+			0x7D75D813F04895B4ULL, 0x702F5B393F62C0E0ULL, 0x0A3FC775F4ECF37FULL, 0xE4B23787A352437FULL,
+			0xF83FA245C34D6363ULL, 0xB99BCF040786CF50ULL, 0x38B6EA0A0E6C9D8AULL, 0x093FDC76776E37E1ULL,
+			0x1A75E6F76BA7EEE8ULL, 0x442CDCFEE9660C62ULL, 0x22D58D35116B5E0BULL, 0x87D4A5180F6A3645ULL,
+			0x589FB216BD82131BULL, 0x91D031CAD319AEC0ULL, 0xABECF76A553D320BULL, 0xB8686CB347612DCFULL,
+			0xFCAB66337C0A77F5ULL, 0xAC318214381EC437ULL, 0x6EB7F0FCA24494AEULL, 0xCF42861DCDC895A9ULL,
+			0x4ABAD7A1586D7A91ULL, 0xC21B318DC2F49745ULL, 0xD49474DC2ACBD1F0ULL, 0xB1D4873747C1C8E1ULL,
+			0x5434DC8C7D015BF6ULL, 0xE1C486287511B6A9ULL, 0xA8616DF62E89A193ULL, 0x31CE6319498D8347ULL,
+			0xAFD0B486123D6FAAULL, 0xE6495F5D102301EBULL, 0x0DC51CED17A43C52ULL, 0x8BCBCDE81355EF2DULL,
+			0x2412AF73FDEE7CFCULL, 0xC8D589E486E29EEDULL, 0x23390E8664517F89ULL, 0x251ADE58E8A6849DULL,
+			0xF8555DBD2E8F9CB0ULL, 0xCB417C3EEF54F7C3ULL, 0x8028F8E1AAC3A919ULL, 0x10E31052ACF748A0ULL,
+			0x2D886C073B1E1B78ULL, 0x972974D90DF9FAEEULL, 0xBC1B7B38796893BAULL, 0x1958ED432070E652ULL,
+			0xCA5F297197A12DCCULL, 0xE025A27375704F28ULL, 0x418010A570A924FBULL, 0x9828E2941BFC419CULL,
+			0x4FBACD2F52B85C1FULL, 0x33DD5B756211CC67ULL, 0x23C8DFDD1DB57FF0ULL, 0x32F81801A1A8E901ULL
+		},
+		{
+			0x26884EAC5ADA36DAULL, 0xCAA82F9BB42E37D4ULL, 0x19FB1A7491D6A7D1ULL, 0x5AA0243AA357F38EULL,
+			0xB31D917809E447F0ULL, 0x3F9C197225215BE0ULL, 0xDC3C315A1E33C095ULL, 0x3DD399AD533E80ACULL,
+			0x566F32CCE8301D95ULL, 0xC880188083D9BA21ULL, 0xB9CC357F3B0E7D2EULL, 0x0237D2123A8A8D6CULL,
+			0xBF636E9AA7CBF6BDULL, 0xD7BD4284C4E2A6A7ULL, 0xDA2EBB47D50577A9ULL, 0x90BA1C11B539087DULL,
+			0x44993D31552B4F57ULL, 0x32C2D6F80A8A8898ULL, 0x450583ED7FB54B19ULL, 0xEC2B0B09E50EF3EFULL,
+			0xD918A0B6E2EFD65CULL, 0xE37A868D9785F572ULL, 0x7D1A6118F2B0F37AULL, 0x9E2E3CC13B343439ULL,
+			0xEFD82C11212E37E8ULL, 0xAF89C05CD4FC75EDULL, 0x55BC16BB9697108EULL, 0x6C4701FA5DB69BEEULL,
+			0x9237338441DAF445ULL, 0x248CF0831E81A5FCULL, 0xACC13557E77DE273ULL, 0x520970C25E06513AULL,
+			0x657329CB02987CABULL, 0xA9B0B3366A4E55A8ULL, 0xC4D06CA2F39ACDD4ULL, 0x5DCE37D68170CDE1ULL,
+			0x5F1E44E77E1854C9ULL, 0x6883D452D55DF899ULL, 0x05C5BD62F1067032ULL, 0xE680B683CE60FAB0ULL,
+			0x5DC9DA3F286D18B1ULL, 0x94B4BF3AB85ED6D8ULL, 0xCE65F449E3ACC5A3ULL, 0x34B0209642CEA639ULL,
+			0xC14C3C771D904827ULL, 0x6ADDCEE2BD9CDEE5ULL, 0xE24EED137FFBB613ULL, 0x75DD58EF79963D1BULL,
+			0xFDB83ECF6CC24920ULL, 0x7A1D0057C57169FBULL, 0x339200F4FEB62D07ULL, 0xD33F4D4AC88469F4ULL,
+			0x8226F234E68DFEE4ULL, 0x320DEF4F2A105536ULL, 0x7786F3B13AEFC159ULL, 0xB28225AC9DF63EE2ULL,
+			0x781B9D0376CC6044ULL, 0x05BD0115226C6AB6ULL, 0xD302230207BDFDABULL, 0xDB898ABD8E0D2933ULL,
+			0x9E79A397BA00B9CCULL, 0x89DF84A5F0003EE8ULL, 0x011F04F2A75FB9BEULL, 0x5A5832BB47BCF19EULL
+		},
+		{
+			0xCBDC6D34B7C7534DULL, 0x28A0D62B36F7E211ULL, 0x56C4553D5D0B9393ULL, 0x6926F3234C55DBF2ULL,
+			0x13FD156D281831ABULL, 0x788FDE493E59653DULL, 0x984456F3129D0DE5ULL, 0x75FEF0B6764F4CBAULL,
+			0x3D1500B0EDF98A29ULL, 0xA149D1519FD97DC4ULL, 0x1288259C4A188588ULL, 0x304014A30B42D718ULL,
+			0x7E9D7E05138F2863ULL, 0x8379EC73F35176F4ULL, 0x72076CAEDAB9CD77ULL, 0x933D40D047D5C211ULL,
+			0x521D6AEC56C0137BULL, 0x4972307F6DA2E896ULL, 0x6381FC65071E876DULL, 0xE5EBA2B5B975969AULL,
+			0xF9819878B6052E93ULL, 0x42CAB1F6274738AFULL, 0xE8E4342AE5CFB767ULL, 0x6EB46BD2BD74A766ULL,
+			0x4DCA29B4FD8880C0ULL, 0xF5DE3740C3CB338DULL, 0x7C0DDDF3352B6DBDULL, 0xA6208F121E7B9D80ULL,
+			0x22BB0C2A84214635ULL, 0x0F721606CABC211EULL, 0xA434826569F1A127ULL, 0x07C801C0F8FE99E7ULL,
+			0x77335155FDF6900BULL, 0x7DE131FF132472A9ULL, 0x9614024D783CE84FULL, 0x0807E7C5EC9C7B14ULL,
+			0x0C5857E188E1C693ULL, 0x3C6250408655F23DULL, 0x1D94501AC76CA8CFULL, 0xA75002A693F4354AULL,
+			0x4BF2D03583341074ULL, 0xCEC9908F230B6711ULL, 0xFC001B32F9982685ULL, 0xA837B30638CACFB2ULL,
+			0xDAA5F80FE9D0F70DULL, 0x45AB1A6A22D6BC17ULL, 0x476CF802330034E5ULL, 0x08B65C623F08199DULL,
+			0x619957D95328EA3CULL, 0xAD6FED10CBDA8DCDULL, 0xEDB0D0D28761FCC0ULL, 0x23A06397A6335D81ULL,
+			0x2649BE21534F387FULL, 0x6BAD9F5F9193499BULL, 0x71CCE7C3593342D9ULL, 0xD6F316C5C285C4DEULL,
+			0xB73A83EEEC718640ULL, 0x2804D8C04DE3388BULL, 0xD9DA1024DC5EA567ULL, 0xF47EC04292326B23ULL,
+			0xA6B94CF241E7E821ULL, 0x0C1DEE5409BC203FULL, 0x33BA05BC3EE276FAULL, 0x032CD31B757B30BBULL
+		},
+		{
+			0x3CCD39A590B78295ULL, 0x4A264B709D0105EFULL, 0x1FA19CFC9778DB71ULL, 0x8436631985E92E8BULL,
+			0x5D34DE04733D0A15ULL, 0x2B181597907BAF2EULL, 0xCECE4D103307428BULL, 0x63A90E6C8F8391C2ULL,
+			0x4C47A8C4017695ECULL, 0x5FE135A23112E31BULL, 0xCBD065FD22102737ULL, 0x63FA700BFC399149ULL,
+			0xE23B1DE2BABAD561ULL, 0x50C2DBEE5D134327ULL, 0x93C051781267EFF5ULL, 0x9AA83A6D8EB8ABB3ULL,
+			0x2D2FE50E4473ADE9ULL, 0x5FA1690E247ADF55ULL, 0x62F4F57B730A8D16ULL, 0x616308740E528066ULL,
+			0x861731F13C272113ULL, 0x3C6CAEC2ABB41615ULL, 0x58DC98D3A4B965DFULL, 0xAC67E58C447A30F3ULL,
+			0x717D1B34D0F226B5ULL, 0x5068123375A5B3C6ULL, 0x65955F41CFD0E893ULL, 0x7A05E7206258C3F8ULL,
+			0x530B98A49018D298ULL, 0x4164A427D5BE9EBBULL, 0x8ED388D35F43AD87ULL, 0xEDA8FA6A8A59BC0EULL,
+			0xA6B3A6712AFCD38AULL, 0x857B0535C58D6B14ULL, 0x35CCC2BF24FBCEB1ULL, 0x91757F9B2437CE51ULL,
+			0x4F9A23E2B151BE74ULL, 0x78779A725EA2D9FEULL, 0xCC4EC68084CC7E95ULL, 0xB6966A6140BF3535ULL,
+			0x89DE59FA33170A0AULL, 0x45891BD34267A6EFULL, 0x68EB3B32AA806AACULL, 0xAE2E7ECC4C8E0DA9ULL,
+			0x9C6973B1CD7C1A97ULL, 0xB2A774C1F3488FB5ULL, 0x00BB92E27D083DCAULL, 0x5D9F2C93FF73A7A1ULL,
+			0xF77EFFEA672D02C9ULL, 0x2C8F635E04E16818ULL, 0x63CCDDA60AB7B0A9ULL, 0x1CCE0BBA630053B2ULL,
+			0xEABD508B9DF52A49ULL, 0x85232B4A312D42A2ULL, 0x907271A5478CDE49ULL, 0x5A63530CFAD0B243ULL,
+			0xAB1A732B3F586B99ULL, 0xADEAE4869D4467B3ULL, 0x2A4176CC70FA8C52ULL, 0x871ED802E15CF126ULL,
+			0x41A665FE26A7A248ULL, 0xE6855668819E63A0ULL, 0x7946342A93638D09ULL, 0xCEE7F6CE76C24791ULL
+		}
+	},
+	{
+		{
+			0x90746E60EF10929CULL, 0x303F222EC15A3656ULL, 0x91CA8850BDB392A5ULL, 0x282BE21753FD8812ULL,
+			0x8DA4658F613BA6A7ULL, 0x39F0F2E09BA26805ULL, 0xE10E043370F4CE5FULL, 0xE3EF8013856FC40CULL,
+			0x10155B096E22E7F7ULL, 0xB06FA4F0D3AFE2D3ULL, 0x98DABB1C64AA2138ULL, 0x662426BD0482CB44ULL,
+			0xD49604A4E3AF5C6AULL, 0x1D73B2634C39403EULL, 0x894FB150A04BE81CULL, 0x2A2E37A33A8F339DULL,
+			0x412B63228C0D97D9ULL, 0xE4534EB1558EA880ULL, 0x22D471EDCC01F620ULL, 0x1810596A0C2284F9ULL,
+			0x55EA875E6EE39C26ULL, 0xFDA91F81674F3233ULL, 0x99FB91542B2EF76CULL, 0x4850117266C0D41FULL,
+			0x4C84FDEEB5B71336ULL, 0x5B65923AC30EC1F4ULL, 0x001FCE785E79EACCULL, 0xE7035AADBA840AF9ULL,
+			0xEF062CFB5D3A3FA4ULL, 0x91CF003DC64D2047ULL, 0x6A6BBAE4C69F0558ULL, 0xBC83EBE6CD2818D8ULL,
+			0xC3A32910D5AEAA2DULL, 0x2F124B01D8C37FF7ULL, 0x89908FB20936C74FULL, 0x30307ACE765D040BULL,
+			0x2EFC3E93492E7D12ULL, 0xB5AF6D95D72949EAULL, 0x9217FA5EC037ABE8ULL, 0xA27CA1090743F1BDULL,
+			0x9E58D128E268BC60ULL, 0x331F5FF8D2F1CCCAULL, 0x1318B39F628757D7ULL, 0xF1EEDCE334401C5EULL,
+			0x10448C3A57DDD877ULL, 0xC6220951FB35D453ULL, 0xA492FA1749559626ULL, 0xC16C742D1CC888F8ULL,
+			0x4EE6BE96E6483C3BULL, 0xD8C4CBBB86AF34BDULL, 0xC23FE6E086E66126ULL, 0x593573115D89D57DULL,
+			0xEAE4B6CA31A0B512ULL, 0x1303E0C57B6E8645ULL, 0xA7CE5911A9CB5E60ULL, 0xAC52A06A93326442ULL,
+			0x1CFA401114D214FEULL, 0x657C7EDD5A6A2D11ULL, 0x74F7DFC8AD75E5BEULL, 0xB93BD966433A5EB5ULL,
+			0x395ABF3428C5EF4DULL, 0x3A7C844C5ED8C333ULL, 0xC6A32156C0E52C52ULL, 0x811E01F4016F91F7ULL
+		},
+		{
+			0x5FD205755DC324CFULL, 0x8B8E6CB9D7A25C5EULL, 0x6A393C91B09A4F24ULL, 0x2419D24941D2879EULL,
+			0xCB11D3D322378C3FULL, 0x89A0D947E7359BA9ULL, 0x9AC235AF1B306EE2ULL, 0xDB17FBEA36289AD2ULL,
+			0x5EDE9C17DEDAFD6BULL, 0xEF0CD7B4E4EC0DE6ULL, 0xA4B32CC50529EC8AULL, 0x3729E60466E76C72ULL,
+			0xBC1B968695DFD347ULL, 0x1208879D7D4BDE63ULL, 0x8ECCC08B8C8DDEFAULL, 0x61D1B6BFDA572C2DULL,
+			0x2E5BFE8AE0BFC011ULL, 0xBB93B47E50DA3162ULL, 0x4DC253BA47FE4964ULL, 0x214619698F00FB1AULL,
+			0x7065DE8FD6721979ULL, 0x319C324C72C708C9ULL, 0x5EF5BBC18466CF1DULL, 0xF1CAE3B64977EEC5ULL,
+			0x6FF929D26A842420ULL, 0xE8BAB64CEF650D0EULL, 0xA0FFF83DF2901695ULL, 0xD0AE24DE4223D192ULL,
+			0xBC60367453EEC23FULL, 0x6D8046B801AFBC9DULL, 0x26018251926C0991ULL, 0x1A68BE3A035B5707ULL,
+			0x242AE4893B70B22EULL, 0xB99C78CBC599A070ULL, 0xED8916B381E9A6E2ULL, 0x37695A55E05CD381ULL,
+			0x5C6C9C4ED6632EE1ULL, 0xCD463F48A9A8274EULL, 0x24E864649FAFA6C7ULL, 0xBA69A8BAC9998133ULL,
+			0x292BB3D3FB84FFD6ULL, 0x32FBF0C6BD46A684ULL, 0xFFA0D42A285685CEULL, 0xF8EC28585E907988ULL,
+			0x955D78582B84939BULL, 0x7A8E5ECE174EC569ULL, 0x0BDE70207D0F01F9ULL, 0xF9D49516F6BCD773ULL,
+			0x5CA61D38ACE08DEAULL, 0x73ACEBD3D49D7857ULL, 0xF4721387D67A23C1ULL, 0x400830FB417EED4FULL,
+			0x43613DB3F0B2E10DULL, 0x0C2683675B3E7196ULL, 0x0F0A3C18070A38E0ULL, 0x00FBA4231F3FD447ULL,
+			0x4A83615E584EA5BBULL, 0xD1C390E9829E2E7DULL, 0x62C7BAE420FE77B5ULL, 0xCA9B275E0CFACC12ULL,
+			0x6E0BB5DF568D5670ULL, 0x47B0F2E81EA86CF0ULL, 0x6B4B89C9CC0875B7ULL, 0x4980AF326A4B65D8ULL
+		},
+		{
+			0x83FCC71FA8833AA3ULL, 0x327EEE6EC9598964ULL, 0x04DFAE11B8DCF861ULL, 0x4C3433717AF5C89AULL,
+			0x22B7BA9E68349351ULL, 0x47666D1B6FCAA9E7ULL, 0x556E1AB391B34D79ULL, 0xA6A3245DD1C3FE53ULL,
+			0xA8241F6FAE45B8D5ULL, 0xC1D7ED7B9C6BEC16ULL, 0x9FC26E2D14919F22ULL, 0x4FC2CCC9159D054FULL,
+			0x4A6881DF0C028B9BULL, 0x45A577F1BAB58960ULL, 0xA1BDB57C6CA2DBC1ULL, 0xEBFDE16CEC9E9974ULL,
+			0x4E7911DDBED4FC71ULL, 0x71E606409319727BULL, 0xDC0D879ED0BBE640ULL, 0x4293A2A13FB2FB89ULL,
+			0xAF24D14180037E79ULL, 0x53BE5793563E006CULL, 0x157786CBC486D2A0ULL, 0xB0752C30EAA58544ULL,
+			0xBB61EE342E9A8210ULL, 0x635D396B1BD1DA07ULL, 0x4D7C14A84BC6FDB5ULL, 0x613A9C99235D15BEULL,
+			0xFB7C05E13C1703FCULL, 0x3F7D3FAA5694D6AEULL, 0x21DC527F0AB4AB9BULL, 0x0251B77B538E03FCULL,
+			0x802E57A14BF8215DULL, 0x51EC9407992AC5B8ULL, 0x48A69543E5DC1734ULL, 0x22ABAA84FD19E270ULL,
+			0x8F34CBB275B951ECULL, 0xDF92F91B1CB7A033ULL, 0x157F0E4CCDB056A8ULL, 0xD889BAB710A7570EULL,
+			0xE180887A35C9ACD9ULL, 0x16C94ED584523D02ULL, 0x3CB6B899028BA353ULL, 0xADE4153860320F39ULL,
+			0x62A15D96596742B3ULL, 0xC24E3101C5AB7A66ULL, 0xD2F48E99A11767A6ULL, 0x1542A77E8DF4CC9FULL,
+			0x70450553F57C306FULL, 0x6596E4BB0AB6FE55ULL, 0xB31AD51EDB07E16DULL, 0x14F8EC0B2DD720C3ULL,
+			0x66623FBEB6A18744ULL, 0xBAC8A59C8FC9F445ULL, 0x0134CF3DE391EAE9ULL, 0x3934DCEA8DD8E425ULL,
+			0x50621C6EBFC34E9BULL, 0xA0D5EE425797481AULL, 0xE65F9512FF9A97F3ULL, 0x12A9FEA1D634C54EULL,
+			0x043AAB402BEAABA8ULL, 0x3FBAAA86D4844270ULL, 0xE179606EAA9381E4ULL, 0x54238CAEBF32828CULL
+		},
+		{
+			0x6E3B64D7F5C88D2BULL, 0x685F1F2FC2E6B27AULL, 0xFD8563EFDE1F4398ULL, 0x4423C5046AA5F8FAULL,
+			0x6BCF56187D539753ULL, 0xD03A3B54209703FBULL, 0x251D485D8178ACD6ULL, 0x3F66CA397592E07FULL,
+			0x552BDFCE433CC6CBULL, 0x44ADDD817DB8B4DFULL, 0xB000CBF3CE21B869ULL, 0xD2E9983A72149FB3ULL,
+			0xAF947E60AD892ED4ULL, 0x577451B6EF6AFCBFULL, 0x78DA7CB7C466FBFDULL, 0xD5E3634444E34975ULL,
+			0x344E8D54603A3643ULL, 0x0B8D292730B546D0ULL, 0x8ACFE26983852BAFULL, 0xF4FE6BA91C741977ULL,
+			0x86D2315D1E0DC68AULL, 0x8D9D062DF69EE643ULL, 0x9BA452EC9B87ACABULL, 0x60D53C599F2EFCF5ULL,
+			0x05CF9A10AE33FD6EULL, 0xED86E1913867A31FULL, 0xCBF6A4EE31486382ULL, 0x5C088030503F61EAULL,
+			0x371DA374BF0BBD06ULL, 0x67325E50CEBAAFC4ULL, 0x40613D7FABC27DF7ULL, 0x873450E33F8EC632ULL,
+			0xC87C2173DD433A8DULL, 0xA337DEFD2FA45812ULL, 0xC6D6572F9C4DB5F7ULL, 0x43DF2A2BB9DC1F8EULL,
+			0xA949F99AE4579AE7ULL, 0x2CE95F8710AF973EULL, 0x9B6F7D1586D5C2A8ULL, 0x1591BCAC785B49B3ULL,
+			0xEFE019EA91A1CDB3ULL, 0x0F308D530055C460ULL, 0x549CBB2EBE9B6412ULL, 0xE45CD3103AC8AFB2ULL,
+			0x8956D2C6A1C2A173ULL, 0x3C6A03F08DF43ECAULL, 0x515E34DF346C7F59ULL, 0xDB1B56D7EFBF053CULL,
+			0xAD13006E7260FC0FULL, 0x9AA291B6D59D39DFULL, 0x3A91DFDA8521DD07ULL, 0x30E27D3A3F4AD189ULL,
+			0x1B7CD23C60E3768EULL, 0x1E65DBAB69F02D4FULL, 0x647B114C433BBAA5ULL, 0x7DCDCA42F34B7DB1ULL,
+			0xC9BC4616C0261CF4ULL, 0xBB980258F543D9BDULL, 0xD0867D4A79935127ULL, 0x7FAA29C4257DE927ULL,
+			0x7C47EFC4DC9DAEB3ULL, 0xFC4455323ED6A688ULL, 0xA6C803AB2FC31DC5ULL, 0xFE3316E8A126C648ULL
+		},
+		{
+			0x0E4D6FEE8331DB63ULL, 0x748CFA660C95016AULL, 0xB2747DBF2BC34ADFULL, 0xFA6ED441E6468E9EULL,
+			0xAE42190933FFC09AULL, 0xFF9C92FD3654A582ULL, 0xD33FCD8CD9E61AC5ULL, 0x371AD28C40094647ULL,
+			0x5D9DC02BB2D14812ULL, 0xAA7BF2B3524699C7ULL, 0x4CB261D764240AF1ULL, 0xEB0074EB49C8F038ULL,
+			0x2235C793C6B2EC94ULL, 0x326CE3DE14B10487ULL, 0x7D26C935D601635CULL, 0xFB023C83C005F89BULL,
+			0x7A7ABFE47CF11A74ULL, 0x326D14295729A098ULL, 0x4051C8E5A0E36E25ULL, 0xAD5FB3DF4788AB9BULL,
+			0xA06E91E446927881ULL, 0x24765F3E77532660ULL, 0x4BA5BDC5384F18C4ULL, 0xC7F4E017F8732292ULL,
+			0x6E992A983B7EDDE2ULL, 0x8E833AEFB26A1864ULL, 0x1BA3ADEE92F08807ULL, 0xD033C438AC3973ADULL,
+			0x109596208F6B9577ULL, 0xC15E6593E972512AULL, 0xCAC8E49BB608B4DAULL, 0x8D2DDA6D5C05DBE7ULL,
+			0x61059BBB11E53600ULL, 0x890DD6765D924D3BULL, 0x326A9A09A42A8F64ULL, 0xBA22CE1E7D55AC2EULL,
+			0x6E3070ECA2371016ULL, 0x4E6545C9F7372BBFULL, 0x44285C955996DB95ULL, 0xC2C610E81CA500CDULL,
+			0x6A2CF7BBC4F311BDULL, 0xFC4B27EAF1CE13B0ULL, 0xB82B569D4298BDEAULL, 0x73CBE4A05D9C604AULL,
+			0x0D0608D17A2F7994ULL, 0xCF7E1D758BC7F5B5ULL, 0x449C532E01903840ULL, 0x109385B3578BC434ULL,
+			0x5B0D87C9FCA26014ULL, 0x491C73C8F628C62AULL, 0x3079EE10EDBE7BA1ULL, 0x0CFF6B3D3E6C15B8ULL,
+			0x1D6B458F2C076C70ULL, 0xC61D459C911F3537ULL, 0xDA68ADBDC675BE53ULL, 0x8DE990E037753AB0ULL,
+			0xA6092D6F9F9E0B84ULL, 0x5B3B3A90AA6AC400ULL, 0x66598CC7B6406583ULL, 0x1CA70AEE97A1B837ULL,
+			0xAF82A4CE58EF93B7ULL, 0xC7CE4B9B13282484ULL, 0x2B889662669711B0ULL, 0x994F1F541E8EC4B1ULL
+		},
+		{
+			0xA04691FBE4451815ULL, 0xE7450F8101BD21D5ULL, 0xAA94A8216C7141A7ULL, 0x06316D1C8DD41B5CULL,
+			0xFE600C367A8AA52BULL, 0x0577481E942A07A3ULL, 0x1A3704F86EEFDE92ULL, 0x1DDD864F1B50782BULL,
+			0x4E6E17F5F3B362DBULL, 0x36C4E9881A205FF0ULL, 0x87615288D5788A80ULL, 0xF0EF34E4BD45B3FCULL,
+			0x1BC57BADAC418D9EULL, 0x9FC338C00035D21BULL, 0x17DDA7EDF8CEA21BULL, 0x9BDAE11A59ED17E3ULL,
+			0x9AEB37281961AF39ULL, 0x426AC051D05D0541ULL, 0x1F6BF9FCBD650853ULL, 0xB6B485C32054D2DBULL,
+			0x33CD737C1BD48BBCULL, 0xBF7D815F20C6AA90ULL, 0xBDDCAA250DAE14BAULL, 0xEADF33672F2EEF00ULL,
+			0x1DFCF9099F404E93ULL, 0x9322250B5159A644ULL, 0xF317F503A92D62BFULL, 0xC81C284DD319FE2FULL,
+			0x6C99B2AAC29B7DA3ULL, 0x09654E59FE299319ULL, 0x7FAC22D4A36C1CDBULL, 0x031C79FC0E5D0BA8ULL,
+			0x6786F2A8B25DF1E6ULL, 0xC5D9B45DC06A2973ULL, 0x494C1BE2F16AA7E5ULL, 0xCD6572B288330281ULL,
+			0x1FEC2AD7E539E591ULL, 0x70FF92EAC7D644EBULL, 0xA23A58E2A5158332ULL, 0x8097046C8FEBEBB5ULL,
+			0xF48EF92917693662ULL, 0xC768ECAF06040013ULL, 0x64DA73F83A1654D7ULL, 0x4653BF0AA21D2E83ULL,
+			0x89CEAA06806A3AB2ULL, 0x11266D2E4DC768E4ULL, 0x72E16539C447B502ULL, 0xFA65940FDED7D4C1ULL,
+			0x4D12ED9B2035457CULL, 0xE945D4CB35ED57EDULL, 0x75D44C13BFFB0F19ULL, 0xF690C8970C88D47AULL,
+			0xE1AE0E7FC137E303ULL, 0x5CE6C3417289B541ULL, 0xD71C344EAB53F9BFULL, 0xAC337044A96DF7AFULL,
+			0xAFE25963A3014E07ULL, 0x5B92F7A78B315407ULL, 0x120A9962FF1FA138ULL, 0xBEC62925BC2C2731ULL,
+			0x840784564071255BULL, 0xB96AC0EE3219851FULL, 0x2B686D2AAF437B55ULL, 0x862CAF81E41A1A19ULL
+		}
+	}
+};
+
+const HashType hash_side = 0x1C787A8631A3CC4CULL;
+
+const HashType hash_ep[64] = {
+	0xADA2B6B30A0FBD78ULL, 0xE9BFF1AC37CD3760ULL, 0x5B1C44F240A786DFULL, 0xDD2E5D6F2B4B30D5ULL,
+	0x74CDD16B7F0FB3C4ULL, 0x39EDBA15BA6D5DEAULL, 0x893A48ADC5C59FC3ULL, 0x5D88D67AC62F910AULL,
+	0x6637C1CE6357A2C8ULL, 0xFC7B432FBA88A23CULL, 0xCBD18EBCD1F9B00DULL, 0xCC5D77CDFDF2F139ULL,
+	0x0F87EEC1B08AFC93ULL, 0xDAD6D0B2EDB856A9ULL, 0xF1967332FB44FE31ULL, 0x7E2EA1F8378A6B05ULL,
+	0xF7030484C2112723ULL, 0xC9270AF5DE5DD831ULL, 0x17B0C92492DB0BE6ULL, 0x65EF9855875761F5ULL,
+	0xF70F6FC08FBC6CD2ULL, 0x31A80F56D1763C8BULL, 0x719544336229E7D2ULL, 0x297D5F1702685620ULL,
+	0xFECAAF16B0750091ULL, 0x4E48827CF8C61F54ULL, 0x041CBEA18AF9BAECULL, 0xBFC582141F1F8448ULL,
+	0x1F2DB364484C8C42ULL, 0xB156CD02F199BF01ULL, 0x805880DF9CD1F3EFULL, 0xF1DE0875B332446FULL,
+	0x81487F13496E7B8AULL, 0xA1C603E2D2B1C755ULL, 0xB5BE0C9A1BB00E12ULL, 0x982FAD98F4955B0BULL,
+	0x6F71EEC14E3C2891ULL, 0xD61F8C52A46143C3ULL, 0x9BE3190D6B9B942EULL, 0x6E8E1898868EB0A2ULL,
+	0x553F7F84144A4C23ULL, 0x228FD26AABA0C661ULL, 0x98EC5EF763A53FCFULL, 0xA6AE40DDDFD3D2F3ULL,
+	0x1A9F21E6E88F29C1ULL, 0x7ABF2E6DBC13D977ULL, 0xBF4E2F41816EA15EULL, 0x3FF81D2834CB6D60ULL,
+	0xA8F148AF30F4B908ULL, 0xD6E2F0E513D0D43EULL, 0xB1BDAB8E9DC78BF4ULL, 0x219142E8B65466F4ULL,
+	0x003F9CF0BCF3D599ULL, 0x4615E70816E98019ULL, 0x533B11BF7E56AAD2ULL, 0x0C5D654DEDAA707AULL,
+	0x72DCA3B0FC2499EDULL, 0x8B733297980FE1B3ULL, 0x999051B19BFB8A9DULL, 0xDD0253A971577375ULL,
+	0x69A7BF83E48E8C0DULL, 0xD7A6AD2B2561D503ULL, 0x7907D7CF9A5031B0ULL, 0x84ED151FF847E34AULL
+};
+
+const HashType hash_castle[16] = {
+	0x0000000000000000ULL, 0x15BE59597232432CULL, 0xFBE3FF25E49E4F60ULL, 0xEE5DA67C96AC0C4CULL,
+	0x5E249603B186FFEEULL, 0x4B9ACF5AC3B4BCC2ULL, 0xA5C769265518B08EULL, 0xB079307F272AF3A2ULL,
+	0x8507C98608EA78C6ULL, 0x90B990DF7AD83BEAULL, 0x7EE436A3EC7437A6ULL, 0x6B5A6FFA9E46748AULL,
+	0xDB235F85B96C8728ULL, 0xCE9D06DCCB5EC404ULL, 0x20C0A0A05DF2C848ULL, 0x357EF9F92FC08B64ULL
+};
+
+/* the pawn masks; see eval.c */
+const uint64 front_mask[2][64] = {
+	{
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000001ULL, 0x0000000000000002ULL, 0x0000000000000004ULL, 0x0000000000000008ULL,
+		0x0000000000000010ULL, 0x0000000000000020ULL, 0x0000000000000040ULL, 0x0000000000000080ULL,
+		0x0000000000000101ULL, 0x0000000000000202ULL, 0x0000000000000404ULL, 0x0000000000000808ULL,
+		0x0000000000001010ULL, 0x0000000000002020ULL, 0x0000000000004040ULL, 0x0000000000008080ULL,
+		0x0000000000010101ULL, 0x0000000000020202ULL, 0x0000000000040404ULL, 0x0000000000080808ULL,
+		0x0000000000101010ULL, 0x0000000000202020ULL, 0x0000000000404040ULL, 0x0000000000808080ULL,
+		0x0000000001010101ULL, 0x0000000002020202ULL, 0x0000000004040404ULL, 0x0000000008080808ULL,
+		0x0000000010101010ULL, 0x0000000020202020ULL, 0x0000000040404040ULL, 0x0000000080808080ULL,
+		0x0000000101010101ULL, 0x0000000202020202ULL, 0x0000000404040404ULL, 0x0000000808080808ULL,
+		0x0000001010101010ULL, 0x0000002020202020ULL, 0x0000004040404040ULL, 0x0000008080808080ULL,
+		0x0000010101010101ULL, 0x0000020202020202ULL, 0x0000040404040404ULL, 0x0000080808080808ULL,
+		0x0000101010101010ULL, 0x0000202020202020ULL, 0x0000404040404040ULL, 0x0000808080808080ULL,
+		0x0001010101010101ULL, 0x0002020202020202ULL, 0x0004040404040404ULL, 0x0008080808080808ULL,
+		0x0010101010101010ULL, 0x0020202020202020ULL, 0x0040404040404040ULL, 0x0080808080808080ULL
+	},
+	{
+		0x0101010101010100ULL, 0x0202020202020200ULL, 0x0404040404040400ULL, 0x0808080808080800ULL,
+		0x1010101010101000ULL, 0x2020202020202000ULL, 0x4040404040404000ULL, 0x8080808080808000ULL,
+		0x0101010101010000ULL, 0x0202020202020000ULL, 0x0404040404040000ULL, 0x0808080808080000ULL,
+		0x1010101010100000ULL, 0x2020202020200000ULL, 0x4040404040400000ULL, 0x8080808080800000ULL,
+		0x0101010101000000ULL, 0x0202020202000000ULL, 0x0404040404000000ULL, 0x0808080808000000ULL,
+		0x1010101010000000ULL, 0x2020202020000000ULL, 0x4040404040000000ULL, 0x8080808080000000ULL,
+		0x0101010100000000ULL, 0x0202020200000000ULL, 0x0404040400000000ULL, 0x0808080800000000ULL,
+		0x1010101000000000ULL, 0x2020202000000000ULL, 0x4040404000000000ULL, 0x8080808000000000ULL,
+		0x0101010000000000ULL, 0x0202020000000000ULL, 0x0404040000000000ULL, 0x0808080000000000ULL,
+		0x1010100000000000ULL, 0x2020200000000000ULL, 0x4040400000000000ULL, 0x8080800000000000ULL,
+		0x0101000000000000ULL, 0x0202000000000000ULL, 0x0404000000000000ULL, 0x0808000000000000ULL,
+		0x1010000000000000ULL, 0x2020000000000000ULL, 0x4040000000000000ULL, 0x8080000000000000ULL,
+		0x0100000000000000ULL, 0x0200000000000000ULL, 0x0400000000000000ULL, 0x0800000000000000ULL,
+		0x1000000000000000ULL, 0x2000000000000000ULL, 0x4000000000000000ULL, 0x8000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL
+	}
+};
+
+const uint64 passed_mask[2][64] = {
+	{
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000003ULL, 0x0000000000000007ULL, 0x000000000000000EULL, 0x000000000000001CULL,
+		0x0000000000000038ULL, 0x0000000000000070ULL, 0x00000000000000E0ULL, 0x00000000000000C0ULL,
+		0x0000000000000303ULL, 0x0000000000000707ULL, 0x0000000000000E0EULL, 0x0000000000001C1CULL,
+		0x0000000000003838ULL, 0x0000000000007070ULL, 0x000000000000E0E0ULL, 0x000000000000C0C0ULL,
+		0x0000000000030303ULL, 0x0000000000070707ULL, 0x00000000000E0E0EULL, 0x00000000001C1C1CULL,
+		0x0000000000383838ULL, 0x0000000000707070ULL, 0x0000000000E0E0E0ULL, 0x0000000000C0C0C0ULL,
+		0x0000000003030303ULL, 0x0000000007070707ULL, 0x000000000E0E0E0EULL, 0x000000001C1C1C1CULL,
+		0x0000000038383838ULL, 0x0000000070707070ULL, 0x00000000E0E0E0E0ULL, 0x00000000C0C0C0C0ULL,
+		0x0000000303030303ULL, 0x0000000707070707ULL, 0x0000000E0E0E0E0EULL, 0x0000001C1C1C1C1CULL,
+		0x0000003838383838ULL, 0x0000007070707070ULL, 0x000000E0E0E0E0E0ULL, 0x000000C0C0C0C0C0ULL,
+		0x0000030303030303ULL, 0x0000070707070707ULL, 0x00000E0E0E0E0E0EULL, 0x00001C1C1C1C1C1CULL,
+		0x0000383838383838ULL, 0x0000707070707070ULL, 0x0000E0E0E0E0E0E0ULL, 0x0000C0C0C0C0C0C0ULL,
+		0x0003030303030303ULL, 0x0007070707070707ULL, 0x000E0E0E0E0E0E0EULL, 0x001C1C1C1C1C1C1CULL,
+		0x0038383838383838ULL, 0x0070707070707070ULL, 0x00E0E0E0E0E0E0E0ULL, 0x00C0C0C0C0C0C0C0ULL
+	},
+	{
+		0x0303030303030300ULL, 0x0707070707070700ULL, 0x0E0E0E0E0E0E0E00ULL, 0x1C1C1C1C1C1C1C00ULL,
+		0x3838383838383800ULL, 0x7070707070707000ULL, 0xE0E0E0E0E0E0E000ULL, 0xC0C0C0C0C0C0C000ULL,
+		0x0303030303030000ULL, 0x0707070707070000ULL, 0x0E0E0E0E0E0E0000ULL, 0x1C1C1C1C1C1C0000ULL,
+		0x3838383838380000ULL, 0x7070707070700000ULL, 0xE0E0E0E0E0E00000ULL, 0xC0C0C0C0C0C00000ULL,
+		0x0303030303000000ULL, 0x0707070707000000ULL, 0x0E0E0E0E0E000000ULL, 0x1C1C1C1C1C000000ULL,
+		0x3838383838000000ULL, 0x7070707070000000ULL, 0xE0E0E0E0E0000000ULL, 0xC0C0C0C0C0000000ULL,
+		0x0303030300000000ULL, 0x0707070700000000ULL, 0x0E0E0E0E00000000ULL, 0x1C1C1C1C00000000ULL,
+		0x3838383800000000ULL, 0x7070707000000000ULL, 0xE0E0E0E000000000ULL, 0xC0C0C0C000000000ULL,
+		0x0303030000000000ULL, 0x0707070000000000ULL, 0x0E0E0E0000000000ULL, 0x1C1C1C0000000000ULL,
+		0x3838380000000000ULL, 0x7070700000000000ULL, 0xE0E0E00000000000ULL, 0xC0C0C00000000000ULL,
+		0x0303000000000000ULL, 0x0707000000000000ULL, 0x0E0E000000000000ULL, 0x1C1C000000000000ULL,
+		0x3838000000000000ULL, 0x7070000000000000ULL, 0xE0E0000000000000ULL, 0xC0C0000000000000ULL,
+		0x0300000000000000ULL, 0x0700000000000000ULL, 0x0E00000000000000ULL, 0x1C00000000000000ULL,
+		0x3800000000000000ULL, 0x7000000000000000ULL, 0xE000000000000000ULL, 0xC000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL
+	}
+};
+
+const uint64 support_mask[2][64] = {
+	{
+		0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+		0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+		0x0202020202020200ULL, 0x0505050505050500ULL, 0x0A0A0A0A0A0A0A00ULL, 0x1414141414141400ULL,
+		0x2828282828282800ULL, 0x5050505050505000ULL, 0xA0A0A0A0A0A0A000ULL, 0x4040404040404000ULL,
+		0x0202020202020000ULL, 0x0505050505050000ULL, 0x0A0A0A0A0A0A0000ULL, 0x1414141414140000ULL,
+		0x2828282828280000ULL, 0x5050505050500000ULL, 0xA0A0A0A0A0A00000ULL, 0x4040404040400000ULL,
+		0x0202020202000000ULL, 0x0505050505000000ULL, 0x0A0A0A0A0A000000ULL, 0x1414141414000000ULL,
+		0x2828282828000000ULL, 0x5050505050000000ULL, 0xA0A0A0A0A0000000ULL, 0x4040404040000000ULL,
+		0x0202020200000000ULL, 0x0505050500000000ULL, 0x0A0A0A0A00000000ULL, 0x1414141400000000ULL,
+		0x2828282800000000ULL, 0x5050505000000000ULL, 0xA0A0A0A000000000ULL, 0x4040404000000000ULL,
+		0x0202020000000000ULL, 0x0505050000000000ULL, 0x0A0A0A0000000000ULL, 0x1414140000000000ULL,
+		0x2828280000000000ULL, 0x5050500000000000ULL, 0xA0A0A00000000000ULL, 0x4040400000000000ULL,
+		0x0202000000000000ULL, 0x0505000000000000ULL, 0x0A0A000000000000ULL, 0x1414000000000000ULL,
+		0x2828000000000000ULL, 0x5050000000000000ULL, 0xA0A0000000000000ULL, 0x4040000000000000ULL,
+		0x0200000000000000ULL, 0x0500000000000000ULL, 0x0A00000000000000ULL, 0x1400000000000000ULL,
+		0x2800000000000000ULL, 0x5000000000000000ULL, 0xA000000000000000ULL, 0x4000000000000000ULL
+	},
+	{
+		0x0000000000000002ULL, 0x0000000000000005ULL, 0x000000000000000AULL, 0x0000000000000014ULL,
+		0x0000000000000028ULL, 0x0000000000000050ULL, 0x00000000000000A0ULL, 0x0000000000000040ULL,
+		0x0000000000000202ULL, 0x0000000000000505ULL, 0x0000000000000A0AULL, 0x0000000000001414ULL,
+		0x0000000000002828ULL, 0x0000000000005050ULL, 0x000000000000A0A0ULL, 0x0000000000004040ULL,
+		0x0000000000020202ULL, 0x0000000000050505ULL, 0x00000000000A0A0AULL, 0x0000000000141414ULL,
+		0x0000000000282828ULL, 0x0000000000505050ULL, 0x0000000000A0A0A0ULL, 0x0000000000404040ULL,
+		0x0000000002020202ULL, 0x0000000005050505ULL, 0x000000000A0A0A0AULL, 0x0000000014141414ULL,
+		0x0000000028282828ULL, 0x0000000050505050ULL, 0x00000000A0A0A0A0ULL, 0x0000000040404040ULL,
+		0x0000000202020202ULL, 0x0000000505050505ULL, 0x0000000A0A0A0A0AULL, 0x0000001414141414ULL,
+		0x0000002828282828ULL, 0x0000005050505050ULL, 0x000000A0A0A0A0A0ULL, 0x0000004040404040ULL,
+		0x0000020202020202ULL, 0x0000050505050505ULL, 0x00000A0A0A0A0A0AULL, 0x0000141414141414ULL,
+		0x0000282828282828ULL, 0x0000505050505050ULL, 0x0000A0A0A0A0A0A0ULL, 0x0000404040404040ULL,
+		0x0002020202020202ULL, 0x0005050505050505ULL, 0x000A0A0A0A0A0A0AULL, 0x0014141414141414ULL,
+		0x0028282828282828ULL, 0x0050505050505050ULL, 0x00A0A0A0A0A0A0A0ULL, 0x0040404040404040ULL,
+		0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+		0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL
+	}
+};
+
+const uint64 isolated_mask[64] = {
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL,
+	0x0202020202020202ULL, 0x0505050505050505ULL, 0x0A0A0A0A0A0A0A0AULL, 0x1414141414141414ULL,
+	0x2828282828282828ULL, 0x5050505050505050ULL, 0xA0A0A0A0A0A0A0A0ULL, 0x4040404040404040ULL
+};
+
+/* the attack tables; see eval.c */
+const uint64 knight_att[64] = {
+	0x0000000000020400ULL, 0x0000000000050800ULL, 0x00000000000A1100ULL, 0x0000000000142200ULL,
+	0x0000000000284400ULL, 0x0000000000508800ULL, 0x0000000000A01000ULL, 0x0000000000402000ULL,
+	0x0000000002040004ULL, 0x0000000005080008ULL, 0x000000000A110011ULL, 0x0000000014220022ULL,
+	0x0000000028440044ULL, 0x0000000050880088ULL, 0x00000000A0100010ULL, 0x0000000040200020ULL,
+	0x0000000204000402ULL, 0x0000000508000805ULL, 0x0000000A1100110AULL, 0x0000001422002214ULL,
+	0x0000002844004428ULL, 0x0000005088008850ULL, 0x000000A0100010A0ULL, 0x0000004020002040ULL,
+	0x0000020400040200ULL, 0x0000050800080500ULL, 0x00000A1100110A00ULL, 0x0000142200221400ULL,
+	0x0000284400442800ULL, 0x0000508800885000ULL, 0x0000A0100010A000ULL, 0x0000402000204000ULL,
+	0x0002040004020000ULL, 0x0005080008050000ULL, 0x000A1100110A0000ULL, 0x0014220022140000ULL,
+	0x0028440044280000ULL, 0x0050880088500000ULL, 0x00A0100010A00000ULL, 0x0040200020400000ULL,
+	0x0204000402000000ULL, 0x0508000805000000ULL, 0x0A1100110A000000ULL, 0x1422002214000000ULL,
+	0x2844004428000000ULL, 0x5088008850000000ULL, 0xA0100010A0000000ULL, 0x4020002040000000ULL,
+	0x0400040200000000ULL, 0x0800080500000000ULL, 0x1100110A00000000ULL, 0x2200221400000000ULL,
+	0x4400442800000000ULL, 0x8800885000000000ULL, 0x100010A000000000ULL, 0x2000204000000000ULL,
+	0x0004020000000000ULL, 0x0008050000000000ULL, 0x00110A0000000000ULL, 0x0022140000000000ULL,
+	0x0044280000000000ULL, 0x0088500000000000ULL, 0x0010A00000000000ULL, 0x0020400000000000ULL
+};
+
+const uint64 king_att[64] = {
+	0x0000000000000302ULL, 0x0000000000000705ULL, 0x0000000000000E0AULL, 0x0000000000001C14ULL,
+	0x0000000000003828ULL, 0x0000000000007050ULL, 0x000000000000E0A0ULL, 0x000000000000C040ULL,
+	0x0000000000030203ULL, 0x0000000000070507ULL, 0x00000000000E0A0EULL, 0x00000000001C141CULL,
+	0x0000000000382838ULL, 0x0000000000705070ULL, 0x0000000000E0A0E0ULL, 0x0000000000C040C0ULL,
+	0x0000000003020300ULL, 0x0000000007050700ULL, 0x000000000E0A0E00ULL, 0x000000001C141C00ULL,
+	0x0000000038283800ULL, 0x0000000070507000ULL, 0x00000000E0A0E000ULL, 0x00000000C040C000ULL,
+	0x0000000302030000ULL, 0x0000000705070000ULL, 0x0000000E0A0E0000ULL, 0x0000001C141C0000ULL,
+	0x0000003828380000ULL, 0x0000007050700000ULL, 0x000000E0A0E00000ULL, 0x000000C040C00000ULL,
+	0x0000030203000000ULL, 0x0000070507000000ULL, 0x00000E0A0E000000ULL, 0x00001C141C000000ULL,
+	0x0000382838000000ULL, 0x0000705070000000ULL, 0x0000E0A0E0000000ULL, 0x0000C040C0000000ULL,
+	0x0003020300000000ULL, 0x0007050700000000ULL, 0x000E0A0E00000000ULL, 0x001C141C00000000ULL,
+	0x0038283800000000ULL, 0x0070507000000000ULL, 0x00E0A0E000000000ULL, 0x00C040C000000000ULL,
+	0x0302030000000000ULL, 0x0705070000000000ULL, 0x0E0A0E0000000000ULL, 0x1C141C0000000000ULL,
+	0x3828380000000000ULL, 0x7050700000000000ULL, 0xE0A0E00000000000ULL, 0xC040C00000000000ULL,
+	0x0203000000000000ULL, 0x0507000000000000ULL, 0x0A0E000000000000ULL, 0x141C000000000000ULL,
+	0x2838000000000000ULL, 0x5070000000000000ULL, 0xA0E0000000000000ULL, 0x40C0000000000000ULL
+};
+
+const uint64 ray[8][64] = {
+	{
+		0x00000000000000FEULL, 0x00000000000000FCULL, 0x00000000000000F8ULL, 0x00000000000000F0ULL,
+		0x00000000000000E0ULL, 0x00000000000000C0ULL, 0x0000000000000080ULL, 0x0000000000000000ULL,
+		0x000000000000FE00ULL, 0x000000000000FC00ULL, 0x000000000000F800ULL, 0x000000000000F000ULL,
+		0x000000000000E000ULL, 0x000000000000C000ULL, 0x0000000000008000ULL, 0x0000000000000000ULL,
+		0x0000000000FE0000ULL, 0x0000000000FC0000ULL, 0x0000000000F80000ULL, 0x0000000000F00000ULL,
+		0x0000000000E00000ULL, 0x0000000000C00000ULL, 0x0000000000800000ULL, 0x0000000000000000ULL,
+		0x00000000FE000000ULL, 0x00000000FC000000ULL, 0x00000000F8000000ULL, 0x00000000F0000000ULL,
+		0x00000000E0000000ULL, 0x00000000C0000000ULL, 0x0000000080000000ULL, 0x0000000000000000ULL,
+		0x000000FE00000000ULL, 0x000000FC00000000ULL, 0x000000F800000000ULL, 0x000000F000000000ULL,
+		0x000000E000000000ULL, 0x000000C000000000ULL, 0x0000008000000000ULL, 0x0000000000000000ULL,
+		0x0000FE0000000000ULL, 0x0000FC0000000000ULL, 0x0000F80000000000ULL, 0x0000F00000000000ULL,
+		0x0000E00000000000ULL, 0x0000C00000000000ULL, 0x0000800000000000ULL, 0x0000000000000000ULL,
+		0x00FE000000000000ULL, 0x00FC000000000000ULL, 0x00F8000000000000ULL, 0x00F0000000000000ULL,
+		0x00E0000000000000ULL, 0x00C0000000000000ULL, 0x0080000000000000ULL, 0x0000000000000000ULL,
+		0xFE00000000000000ULL, 0xFC00000000000000ULL, 0xF800000000000000ULL, 0xF000000000000000ULL,
+		0xE000000000000000ULL, 0xC000000000000000ULL, 0x8000000000000000ULL, 0x0000000000000000ULL
+	},
+	{
+		0x0000000000000000ULL, 0x0000000000000100ULL, 0x0000000000010200ULL, 0x0000000001020400ULL,
+		0x0000000102040800ULL, 0x0000010204081000ULL, 0x0001020408102000ULL, 0x0102040810204000ULL,
+		0x0000000000000000ULL, 0x0000000000010000ULL, 0x0000000001020000ULL, 0x0000000102040000ULL,
+		0x0000010204080000ULL, 0x0001020408100000ULL, 0x0102040810200000ULL, 0x0204081020400000ULL,
+		0x0000000000000000ULL, 0x0000000001000000ULL, 0x0000000102000000ULL, 0x0000010204000000ULL,
+		0x0001020408000000ULL, 0x0102040810000000ULL, 0x0204081020000000ULL, 0x0408102040000000ULL,
+		0x0000000000000000ULL, 0x0000000100000000ULL, 0x0000010200000000ULL, 0x0001020400000000ULL,
+		0x0102040800000000ULL, 0x0204081000000000ULL, 0x0408102000000000ULL, 0x0810204000000000ULL,
+		0x0000000000000000ULL, 0x0000010000000000ULL, 0x0001020000000000ULL, 0x0102040000000000ULL,
+		0x0204080000000000ULL, 0x0408100000000000ULL, 0x0810200000000000ULL, 0x1020400000000000ULL,
+		0x0000000000000000ULL, 0x0001000000000000ULL, 0x0102000000000000ULL, 0x0204000000000000ULL,
+		0x0408000000000000ULL, 0x0810000000000000ULL, 0x1020000000000000ULL, 0x2040000000000000ULL,
+		0x0000000000000000ULL, 0x0100000000000000ULL, 0x0200000000000000ULL, 0x0400000000000000ULL,
+		0x0800000000000000ULL, 0x1000000000000000ULL, 0x2000000000000000ULL, 0x4000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL
+	},
+	{
+		0x0101010101010100ULL, 0x0202020202020200ULL, 0x0404040404040400ULL, 0x0808080808080800ULL,
+		0x1010101010101000ULL, 0x2020202020202000ULL, 0x4040404040404000ULL, 0x8080808080808000ULL,
+		0x0101010101010000ULL, 0x0202020202020000ULL, 0x0404040404040000ULL, 0x0808080808080000ULL,
+		0x1010101010100000ULL, 0x2020202020200000ULL, 0x4040404040400000ULL, 0x8080808080800000ULL,
+		0x0101010101000000ULL, 0x0202020202000000ULL, 0x0404040404000000ULL, 0x0808080808000000ULL,
+		0x1010101010000000ULL, 0x2020202020000000ULL, 0x4040404040000000ULL, 0x8080808080000000ULL,
+		0x0101010100000000ULL, 0x0202020200000000ULL, 0x0404040400000000ULL, 0x0808080800000000ULL,
+		0x1010101000000000ULL, 0x2020202000000000ULL, 0x4040404000000000ULL, 0x8080808000000000ULL,
+		0x0101010000000000ULL, 0x0202020000000000ULL, 0x0404040000000000ULL, 0x0808080000000000ULL,
+		0x1010100000000000ULL, 0x2020200000000000ULL, 0x4040400000000000ULL, 0x8080800000000000ULL,
+		0x0101000000000000ULL, 0x0202000000000000ULL, 0x0404000000000000ULL, 0x0808000000000000ULL,
+		0x1010000000000000ULL, 0x2020000000000000ULL, 0x4040000000000000ULL, 0x8080000000000000ULL,
+		0x0100000000000000ULL, 0x0200000000000000ULL, 0x0400000000000000ULL, 0x0800000000000000ULL,
+		0x1000000000000000ULL, 0x2000000000000000ULL, 0x4000000000000000ULL, 0x8000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL
+	},
+	{
+		0x8040201008040200ULL, 0x0080402010080400ULL, 0x0000804020100800ULL, 0x0000008040201000ULL,
+		0x0000000080402000ULL, 0x0000000000804000ULL, 0x0000000000008000ULL, 0x0000000000000000ULL,
+		0x4020100804020000ULL, 0x8040201008040000ULL, 0x0080402010080000ULL, 0x0000804020100000ULL,
+		0x0000008040200000ULL, 0x0000000080400000ULL, 0x0000000000800000ULL, 0x0000000000000000ULL,
+		0x2010080402000000ULL, 0x4020100804000000ULL, 0x8040201008000000ULL, 0x0080402010000000ULL,
+		0x0000804020000000ULL, 0x0000008040000000ULL, 0x0000000080000000ULL, 0x0000000000000000ULL,
+		0x1008040200000000ULL, 0x2010080400000000ULL, 0x4020100800000000ULL, 0x8040201000000000ULL,
+		0x0080402000000000ULL, 0x0000804000000000ULL, 0x0000008000000000ULL, 0x0000000000000000ULL,
+		0x0804020000000000ULL, 0x1008040000000000ULL, 0x2010080000000000ULL, 0x4020100000000000ULL,
+		0x8040200000000000ULL, 0x0080400000000000ULL, 0x0000800000000000ULL, 0x0000000000000000ULL,
+		0x0402000000000000ULL, 0x0804000000000000ULL, 0x1008000000000000ULL, 0x2010000000000000ULL,
+		0x4020000000000000ULL, 0x8040000000000000ULL, 0x0080000000000000ULL, 0x0000000000000000ULL,
+		0x0200000000000000ULL, 0x0400000000000000ULL, 0x0800000000000000ULL, 0x1000000000000000ULL,
+		0x2000000000000000ULL, 0x4000000000000000ULL, 0x8000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL
+	},
+	{
+		0x0000000000000000ULL, 0x0000000000000001ULL, 0x0000000000000003ULL, 0x0000000000000007ULL,
+		0x000000000000000FULL, 0x000000000000001FULL, 0x000000000000003FULL, 0x000000000000007FULL,
+		0x0000000000000000ULL, 0x0000000000000100ULL, 0x0000000000000300ULL, 0x0000000000000700ULL,
+		0x0000000000000F00ULL, 0x0000000000001F00ULL, 0x0000000000003F00ULL, 0x0000000000007F00ULL,
+		0x0000000000000000ULL, 0x0000000000010000ULL, 0x0000000000030000ULL, 0x0000000000070000ULL,
+		0x00000000000F0000ULL, 0x00000000001F0000ULL, 0x00000000003F0000ULL, 0x00000000007F0000ULL,
+		0x0000000000000000ULL, 0x0000000001000000ULL, 0x0000000003000000ULL, 0x0000000007000000ULL,
+		0x000000000F000000ULL, 0x000000001F000000ULL, 0x000000003F000000ULL, 0x000000007F000000ULL,
+		0x0000000000000000ULL, 0x0000000100000000ULL, 0x0000000300000000ULL, 0x0000000700000000ULL,
+		0x0000000F00000000ULL, 0x0000001F00000000ULL, 0x0000003F00000000ULL, 0x0000007F00000000ULL,
+		0x0000000000000000ULL, 0x0000010000000000ULL, 0x0000030000000000ULL, 0x0000070000000000ULL,
+		0x00000F0000000000ULL, 0x00001F0000000000ULL, 0x00003F0000000000ULL, 0x00007F0000000000ULL,
+		0x0000000000000000ULL, 0x0001000000000000ULL, 0x0003000000000000ULL, 0x0007000000000000ULL,
+		0x000F000000000000ULL, 0x001F000000000000ULL, 0x003F000000000000ULL, 0x007F000000000000ULL,
+		0x0000000000000000ULL, 0x0100000000000000ULL, 0x0300000000000000ULL, 0x0700000000000000ULL,
+		0x0F00000000000000ULL, 0x1F00000000000000ULL, 0x3F00000000000000ULL, 0x7F00000000000000ULL
+	},
+	{
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000002ULL, 0x0000000000000004ULL, 0x0000000000000008ULL, 0x0000000000000010ULL,
+		0x0000000000000020ULL, 0x0000000000000040ULL, 0x0000000000000080ULL, 0x0000000000000000ULL,
+		0x0000000000000204ULL, 0x0000000000000408ULL, 0x0000000000000810ULL, 0x0000000000001020ULL,
+		0x0000000000002040ULL, 0x0000000000004080ULL, 0x0000000000008000ULL, 0x0000000000000000ULL,
+		0x0000000000020408ULL, 0x0000000000040810ULL, 0x0000000000081020ULL, 0x0000000000102040ULL,
+		0x0000000000204080ULL, 0x0000000000408000ULL, 0x0000000000800000ULL, 0x0000000000000000ULL,
+		0x0000000002040810ULL, 0x0000000004081020ULL, 0x0000000008102040ULL, 0x0000000010204080ULL,
+		0x0000000020408000ULL, 0x0000000040800000ULL, 0x0000000080000000ULL, 0x0000000000000000ULL,
+		0x0000000204081020ULL, 0x0000000408102040ULL, 0x0000000810204080ULL, 0x0000001020408000ULL,
+		0x0000002040800000ULL, 0x0000004080000000ULL, 0x0000008000000000ULL, 0x0000000000000000ULL,
+		0x0000020408102040ULL, 0x0000040810204080ULL, 0x0000081020408000ULL, 0x0000102040800000ULL,
+		0x0000204080000000ULL, 0x0000408000000000ULL, 0x0000800000000000ULL, 0x0000000000000000ULL,
+		0x0002040810204080ULL, 0x0004081020408000ULL, 0x0008102040800000ULL, 0x0010204080000000ULL,
+		0x0020408000000000ULL, 0x0040800000000000ULL, 0x0080000000000000ULL, 0x0000000000000000ULL
+	},
+	{
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000001ULL, 0x0000000000000002ULL, 0x0000000000000004ULL, 0x0000000000000008ULL,
+		0x0000000000000010ULL, 0x0000000000000020ULL, 0x0000000000000040ULL, 0x0000000000000080ULL,
+		0x0000000000000101ULL, 0x0000000000000202ULL, 0x0000000000000404ULL, 0x0000000000000808ULL,
+		0x0000000000001010ULL, 0x0000000000002020ULL, 0x0000000000004040ULL, 0x0000000000008080ULL,
+		0x0000000000010101ULL, 0x0000000000020202ULL, 0x0000000000040404ULL, 0x0000000000080808ULL,
+		0x0000000000101010ULL, 0x0000000000202020ULL, 0x0000000000404040ULL, 0x0000000000808080ULL,
+		0x0000000001010101ULL, 0x0000000002020202ULL, 0x0000000004040404ULL, 0x0000000008080808ULL,
+		0x0000000010101010ULL, 0x0000000020202020ULL, 0x0000000040404040ULL, 0x0000000080808080ULL,
+		0x0000000101010101ULL, 0x0000000202020202ULL, 0x0000000404040404ULL, 0x0000000808080808ULL,
+		0x0000001010101010ULL, 0x0000002020202020ULL, 0x0000004040404040ULL, 0x0000008080808080ULL,
+		0x0000010101010101ULL, 0x0000020202020202ULL, 0x0000040404040404ULL, 0x0000080808080808ULL,
+		0x0000101010101010ULL, 0x0000202020202020ULL, 0x0000404040404040ULL, 0x0000808080808080ULL,
+		0x0001010101010101ULL, 0x0002020202020202ULL, 0x0004040404040404ULL, 0x0008080808080808ULL,
+		0x0010101010101010ULL, 0x0020202020202020ULL, 0x0040404040404040ULL, 0x0080808080808080ULL
+	},
+	{
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL, 0x0000000000000000ULL,
+		0x0000000000000000ULL, 0x0000000000000001ULL, 0x0000000000000002ULL, 0x0000000000000004ULL,
+		0x0000000000000008ULL, 0x0000000000000010ULL, 0x0000000000000020ULL, 0x0000000000000040ULL,
+		0x0000000000000000ULL, 0x0000000000000100ULL, 0x0000000000000201ULL, 0x0000000000000402ULL,
+		0x0000000000000804ULL, 0x0000000000001008ULL, 0x0000000000002010ULL, 0x0000000000004020ULL,
+		0x0000000000000000ULL, 0x0000000000010000ULL, 0x0000000000020100ULL, 0x0000000000040201ULL,
+		0x0000000000080402ULL, 0x0000000000100804ULL, 0x0000000000201008ULL, 0x0000000000402010ULL,
+		0x0000000000000000ULL, 0x0000000001000000ULL, 0x0000000002010000ULL, 0x0000000004020100ULL,
+		0x0000000008040201ULL, 0x0000000010080402ULL, 0x0000000020100804ULL, 0x0000000040201008ULL,
+		0x0000000000000000ULL, 0x0000000100000000ULL, 0x0000000201000000ULL, 0x0000000402010000ULL,
+		0x0000000804020100ULL, 0x0000001008040201ULL, 0x0000002010080402ULL, 0x0000004020100804ULL,
+		0x0000000000000000ULL, 0x0000010000000000ULL, 0x0000020100000000ULL, 0x0000040201000000ULL,
+		0x0000080402010000ULL, 0x0000100804020100ULL, 0x0000201008040201ULL, 0x0000402010080402ULL,
+		0x0000000000000000ULL, 0x0001000000000000ULL, 0x0002010000000000ULL, 0x0004020100000000ULL,
+		0x0008040201000000ULL, 0x0010080402010000ULL, 0x0020100804020100ULL, 0x0040201008040201ULL
+	}
+};
+
@@ -0,0 +1,134 @@
+/*
+ *	THREAD.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Running a function in several threads
+ */
+
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+typedef struct {
+	void (*f)(int, void *);
+	int i;
+	void *arg;
+} job_t;
+
+#ifdef _WIN32
+static DWORD WINAPI start_job(LPVOID p)
+{
+	job_t *j = (job_t *)p;
+
+	j->f(j->i, j->arg);
+	return 0;
+}
+#else
+static void *start_job(void *p)
+{
+	job_t *j = (job_t *)p;
+
+	j->f(j->i, j->arg);
+	return NULL;
+}
+#endif
+
+
+/* join_thread() waits for thread t to finish */
+
+#ifdef _WIN32
+static void join_thread(HANDLE t)
+{
+	WaitForSingleObject(t, INFINITE);
+	CloseHandle(t);
+}
+#else
+static void join_thread(pthread_t t)
+{
+	pthread_join(t, NULL);
+}
+#endif
+
+
+/* run_threads() calls f(i, arg) for i = 0 to n - 1, each call in a new
+   thread, and returns once they've all finished. The engine state in
+   data.c is THREAD_LOCAL, so each thread has its own board; the calling
+   thread's is left alone. In deterministic mode, each thread finishes
+   before the next one starts.
+
+   If a thread can't be created, f(i, arg) is called by the calling
+   thread instead, so none of the work is skipped. Its board is then
+   whatever f left it as, but it keeps its part of the hash table. */
+
+void run_threads(int n, void (*f)(int, void *), void *arg)
+{
+	job_t job[MAX_THREADS];
+	BOOL started[MAX_THREADS];
+	HtBucket *table = tt_table;
+	unsigned int buckets = tt_buckets;
+	int i;
+#ifdef _WIN32
+	HANDLE t[MAX_THREADS];
+#else
+	pthread_t t[MAX_THREADS];
+#endif
+
+	if (n > MAX_THREADS)
+		n = MAX_THREADS;
+	for (i = 0; i < n; ++i) {
+		job[i].f = f;
+		job[i].i = i;
+		job[i].arg = arg;
+#ifdef _WIN32
+		t[i] = CreateThread(NULL, 0, start_job, &job[i], 0, NULL);
+		started[i] = (t[i] != NULL);
+#else
+		started[i] = (pthread_create(&t[i], NULL, start_job, &job[i]) == 0);
+#endif
+		if (!started[i]) {
+			f(i, arg);
+			tt_table = table;
+			tt_buckets = buckets;
+		}
+		else if (deterministic)
+			join_thread(t[i]);
+	}
+	if (!deterministic)
+		for (i = 0; i < n; ++i)
+			if (started[i])
+				join_thread(t[i]);
+}
+
+
+/* cpu_count() returns the number of processors, up to MAX_THREADS, or 1
+   in deterministic mode, so work split between threads is split the
+   same way on every machine */
+
+int cpu_count()
+{
+	int n;
+
+	if (deterministic)
+		return 1;
+#ifdef _WIN32
+	SYSTEM_INFO si;
+
+	GetSystemInfo(&si);
+	n = (int)si.dwNumberOfProcessors;
+#else
+	n = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (n < 1)
+		n = 1;
+	if (n > MAX_THREADS)
+		n = MAX_THREADS;
+	return n;
+}
@@ -0,0 +1,296 @@
+/*
+ *	TRACE.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Writing the search tree to a file, and reading it back
+ */
+
+
+/* With TRACE defined (see defs.h), the "trace" command has search() and
+   quiesce() write a record of every node they finish: its hash key, the
+   move that led to it, its ply and depth, alpha and beta, the score it
+   returned, how many moves were searched before one failed high, and
+   the size of its subtree. The records go to a ring of TRACE_RECORDS in
+   a file mapped into memory, so writing one costs a few stores and the
+   operating system writes the file out when it likes. When the ring is
+   full, the oldest records are overwritten.
+
+   A node is written when it returns, so the file holds the tree in
+   postorder: a node's children come just before it, each after its own
+   children, so the move that failed high at a node is the move of its
+   last child. That's enough to find the root moves of the last
+   iteration and what they cost. The "tracestat" command reads a trace
+   file (it doesn't need TRACE) and prints where the nodes went and
+   which fail highs came late in the move order.
+
+   The records are written in the byte order of the machine, so a trace
+   file has to be read on the kind of machine that wrote it. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>  /* before defs.h, which defines BOOL */
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+#define TRACE_MAGIC		"TSCPTRC1"
+#define TRACE_TOP		10  /* the ordering failures tracestat lists */
+
+/* the start of a trace file */
+typedef struct {
+	char magic[8];  /* TRACE_MAGIC */
+	unsigned int record_size;  /* sizeof(trace_record_t) */
+	unsigned int records;  /* the size of the ring */
+	uint64 count;  /* the records written; the next goes at count % records */
+	char pad[40];  /* so the records start on a cache line */
+} trace_header_t;
+
+/* a node */
+typedef struct {
+	HashType hash;
+	unsigned int nodes;  /* the nodes searched in its subtree, itself included */
+	short alpha;  /* the bounds it was called with */
+	short beta;
+	short score;  /* what it returned */
+	move m;  /* the move that led to it; 0 at the root */
+	unsigned char ply;
+	signed char depth;  /* 0 for quiesce() */
+	unsigned char cut;  /* the moves searched before one failed high, or TRACE_NONE */
+	unsigned char flags;
+} trace_record_t;
+
+static trace_header_t *trace_file;  /* the mapped file */
+static trace_record_t *trace_ring;  /* its records */
+static size_t trace_size;
+#ifdef _WIN32
+static HANDLE trace_map;
+#endif
+
+
+/* trace_open() creates the trace file s and starts writing the nodes the
+   calling thread searches to it. It returns FALSE if the file can't be
+   made. */
+
+BOOL trace_open(char *s)
+{
+	trace_close();
+	trace_size = sizeof(trace_header_t) + (size_t)TRACE_RECORDS * sizeof(trace_record_t);
+#ifdef _WIN32
+	HANDLE h = CreateFileA(s, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+			CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (h == INVALID_HANDLE_VALUE)
+		return FALSE;
+	trace_map = CreateFileMappingA(h, NULL, PAGE_READWRITE,
+			(DWORD)((unsigned long long)trace_size >> 32), (DWORD)trace_size, NULL);
+	if (trace_map)
+		trace_file = (trace_header_t *)MapViewOfFile(trace_map, FILE_MAP_WRITE, 0, 0, 0);
+	CloseHandle(h);
+	if (!trace_file) {
+		if (trace_map)
+			CloseHandle(trace_map);
+		return FALSE;
+	}
+#else
+	int fd = open(s, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+	if (fd == -1)
+		return FALSE;
+	if (ftruncate(fd, (off_t)trace_size) == 0)
+		trace_file = (trace_header_t *)mmap(NULL, trace_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED, fd, 0);
+	close(fd);
+	if (!trace_file || trace_file == (trace_header_t *)MAP_FAILED) {
+		trace_file = NULL;
+		return FALSE;
+	}
+#endif
+	memcpy(trace_file->magic, TRACE_MAGIC, 8);
+	trace_file->record_size = sizeof(trace_record_t);
+	trace_file->records = TRACE_RECORDS;
+	trace_file->count = 0;
+	trace_ring = (trace_record_t *)(trace_file + 1);
+	trace_on = TRUE;
+	return TRUE;
+}
+
+
+/* trace_close() stops tracing and unmaps the file. It returns the number
+   of nodes that were written. */
+
+unsigned long long trace_close()
+{
+	unsigned long long n = 0;
+
+	trace_on = FALSE;
+	if (trace_file) {
+		n = trace_file->count;
+#ifdef _WIN32
+		UnmapViewOfFile(trace_file);
+		CloseHandle(trace_map);
+#else
+		munmap(trace_file, trace_size);
+#endif
+	}
+	trace_file = NULL;
+	trace_ring = NULL;
+	return n;
+}
+
+
+/* trace_node() writes the record of the node search() or quiesce() (if
+   flags has TRACE_QUIESCE) just finished at this ply. It was called with
+   alpha, beta, and depth, returned score, and searched n nodes. */
+
+void trace_node(int alpha, int beta, int depth, int score, int flags,
+		unsigned long long n)
+{
+	trace_record_t *r = &trace_ring[trace_file->count++ & (TRACE_RECORDS - 1)];
+
+	r->hash = hash;
+	r->nodes = (unsigned int)n;
+	r->alpha = (short)alpha;
+	r->beta = (short)beta;
+	r->score = (short)score;
+	r->ply = (unsigned char)ply;
+	r->depth = (signed char)depth;
+	r->flags = (unsigned char)flags;
+	r->m = ply ? hist_dat[hply - 1].m : 0;
+	r->cut = (score >= beta) ? trace_cut[ply] : TRACE_NONE;
+}
+
+
+/* print_record() prints a record for tracestat */
+
+static void print_record(trace_record_t *r)
+{
+	printf("%3d %5d  %016llX  %-6s %4d %9u  %6d %6d %6d\n", r->ply, r->depth,
+			(unsigned long long)r->hash, r->m ? move_str(r->m) : "-", r->cut,
+			r->nodes, r->alpha, r->beta, r->score);
+}
+
+
+/* trace_stat() is the "tracestat" command: it summarizes the trace file s */
+
+void trace_stat(char *s)
+{
+	FILE *f;
+	trace_header_t h;
+	trace_record_t *r, *top[TRACE_TOP], *t;
+	unsigned long long cuts[2][6];  /* fail highs by cut: 0, 1, 2, 3, 4-7, 8 or more */
+	unsigned long long kind[2];  /* the nodes of search() and quiesce() */
+	unsigned long long total;
+	size_t n, first;
+	int i, j, q, b;
+	long last;
+
+	f = fopen(s, "rb");
+	if (!f) {
+		printf("Can't open %s.\n", s);
+		return;
+	}
+	if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, TRACE_MAGIC, 8) ||
+			h.record_size != sizeof(trace_record_t) || !h.records) {
+		printf("%s isn't a trace file.\n", s);
+		fclose(f);
+		return;
+	}
+
+	/* read the ring from its oldest record */
+	n = h.count < h.records ? (size_t)h.count : h.records;
+	first = h.count < h.records ? 0 : (size_t)(h.count % h.records);
+	r = (trace_record_t *)malloc((n ? n : 1) * sizeof(trace_record_t));
+	if (!r) {
+		printf("Out of memory.\n");
+		fclose(f);
+		return;
+	}
+	fseek(f, (long)(sizeof(h) + first * sizeof(trace_record_t)), SEEK_SET);
+	i = fread(r, sizeof(trace_record_t), n - first, f) != n - first;
+	fseek(f, (long)sizeof(h), SEEK_SET);
+	if (first && fread(r + n - first, sizeof(trace_record_t), first, f) != first)
+		i = 1;
+	fclose(f);
+	if (i) {
+		printf("%s is cut short.\n", s);
+		free(r);
+		return;
+	}
+	printf("%llu nodes traced, the last %llu of them in the file\n",
+			(unsigned long long)h.count, (unsigned long long)n);
+
+	/* fail highs by how late in the move order they came */
+	memset(cuts, 0, sizeof(cuts));
+	memset(kind, 0, sizeof(kind));
+	memset(top, 0, sizeof(top));
+	for (t = r; t < r + n; ++t) {
+		q = (t->flags & TRACE_QUIESCE) ? 1 : 0;
+		++kind[q];
+		if (t->cut == TRACE_NONE)
+			continue;
+		b = t->cut < 4 ? t->cut : (t->cut < 8 ? 4 : 5);
+		++cuts[q][b];
+
+		/* keep the TRACE_TOP biggest subtrees of late fail highs, once
+		   for each position and depth */
+		if (!t->cut || (top[TRACE_TOP - 1] && t->nodes <= top[TRACE_TOP - 1]->nodes))
+			continue;
+		for (i = 0; i < TRACE_TOP && top[i] && (top[i]->hash != t->hash ||
+				top[i]->depth != t->depth); ++i)
+			;
+		if (i < TRACE_TOP && top[i]) {
+			if (top[i]->nodes >= t->nodes)
+				continue;
+			for (; i < TRACE_TOP - 1; ++i)
+				top[i] = top[i + 1];
+			top[i] = NULL;
+		}
+		for (i = TRACE_TOP - 1; i > 0 && (!top[i - 1] || top[i - 1]->nodes < t->nodes); --i)
+			top[i] = top[i - 1];
+		top[i] = t;
+	}
+	printf("search() nodes: %llu, quiesce() nodes: %llu\n", kind[0], kind[1]);
+	printf("\n");
+	printf("fail highs by the moves searched before the cutoff:\n");
+	printf("             0        1        2        3      4-7       8+  first\n");
+	for (q = 0; q < 2; ++q) {
+		total = 0;
+		for (b = 0; b < 6; ++b)
+			total += cuts[q][b];
+		printf("%-8s", q ? "quiesce" : "search");
+		for (b = 0; b < 6; ++b)
+			printf(" %8llu", cuts[q][b]);
+		printf(" %5.1f%%\n", total ? 100.0 * (double)cuts[q][0] / (double)total : 0.0);
+	}
+	printf("\n");
+	printf("the biggest subtrees that failed high late:\n");
+	printf("ply depth  hash              move    cut     nodes   alpha   beta  score\n");
+	for (i = 0; i < TRACE_TOP && top[i]; ++i)
+		print_record(top[i]);
+
+	/* the root moves of the last iteration in the file: the ply 1 nodes
+	   between the last two roots */
+	for (last = (long)n - 1; last >= 0 && (r[last].ply || (r[last].flags & TRACE_QUIESCE)); --last)
+		;
+	if (last >= 0) {
+		printf("\n");
+		printf("the root moves of the last iteration (depth %d, %u nodes):\n",
+				r[last].depth, r[last].nodes);
+		printf("ply depth  hash              move    cut     nodes   alpha   beta  score\n");
+		for (j = (int)last - 1; j >= 0 && r[j].ply; --j)
+			;
+		for (i = j + 1; i < last; ++i)
+			if (r[i].ply == 1)
+				print_record(&r[i]);
+	}
+	free(r);
+}
@@ -0,0 +1,401 @@
+/*
+ *	TUNE.C
+ *	Tom Kerrigan's Simple Chess Program (TSCP)
+ *
+ *	Tuning the evaluation terms
+ */
+
+
+/* tune() adjusts the evaluation terms in eval.c to fit the results of a
+   set of games, the way Peter Osterlund tuned Texel:
+
+   - each position is scored with quiesce(), and the score is turned into
+     an expected result with the logistic function 1 / (1 + 10^(-K*s/400)).
+   - the error is the mean squared difference between the expected and
+     the actual results. K is chosen first, to minimize the error with
+     the current terms.
+   - then each term is moved up or down by one, and the change is kept
+     if the error goes down, until a pass over all the terms changes
+     nothing.
+
+   The positions come from an EPD file with the result of the game in the
+   rest of the line ("1-0", "0-1", "1/2-1/2", or [1.0], [0.0], [0.5]).
+   They're kept in a compact form, and each error computation is split
+   between one thread per processor. The terms are written to TUNE_FILE
+   after every pass, in the same form as in eval.c. */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "defs.h"
+#include "data.h"
+#include "protos.h"
+
+
+/* a position as it's stored while tuning: 35 bytes instead of a board */
+typedef struct {
+	unsigned char sq[32];  /* two squares per byte: 0 if empty, or 1 + color * 6 + piece */
+	unsigned char flags;  /* castle in bits 0-3, the side to move in bit 4 */
+	signed char ep;
+	unsigned char result;  /* 2 if white won, 1 for a draw, 0 if black won */
+} tpos_t;
+
+static tpos_t *tpos;
+static int tpos_count;
+static double tune_k;
+static int threads;
+static long long tune_positions;  /* positions scored so far */
+
+/* a thread's share of an error computation */
+typedef struct {
+	int first;
+	int last;
+	int *score;  /* if not NULL, quiesce() scores are stored here */
+	double error;
+} slice_t;
+
+/* the terms that are tuned. Elements outside first..last are left alone:
+   the pawn value sets the scale, and pawns are never on the first or last
+   rank. */
+typedef struct {
+	char *name;
+	int *value;
+	int count;  /* 1 for a single variable */
+	int first;
+	int last;
+} param_t;
+
+static param_t param[] = {
+	{ "doubled_pawn_penalty", &doubled_pawn_penalty, 1, 0, 0 },
+	{ "isolated_pawn_penalty", &isolated_pawn_penalty, 1, 0, 0 },
+	{ "backwards_pawn_penalty", &backwards_pawn_penalty, 1, 0, 0 },
+	{ "passed_pawn_bonus", &passed_pawn_bonus, 1, 0, 0 },
+	{ "candidate_pawn_bonus", &candidate_pawn_bonus, 1, 0, 0 },
+	{ "rook_semi_open_file_bonus", &rook_semi_open_file_bonus, 1, 0, 0 },
+	{ "rook_open_file_bonus", &rook_open_file_bonus, 1, 0, 0 },
+	{ "rook_on_seventh_bonus", &rook_on_seventh_bonus, 1, 0, 0 },
+	{ "shield_pawn", shield_pawn, 3, 0, 2 },
+	{ "shield_storm", shield_storm, 3, 0, 2 },
+	{ "shield_open_file", &shield_open_file, 1, 0, 0 },
+	{ "mobility_bonus", mobility_bonus, 6, KNIGHT, QUEEN },
+	{ "king_attack_bonus", king_attack_bonus, 6, KNIGHT, QUEEN },
+	{ "hanging_piece_penalty", &hanging_piece_penalty, 1, 0, 0 },
+	{ "piece_value", piece_value, 6, KNIGHT, QUEEN },
+	{ "pawn_pcsq", pawn_pcsq, 64, 8, 55 },
+	{ "knight_pcsq", knight_pcsq, 64, 0, 63 },
+	{ "bishop_pcsq", bishop_pcsq, 64, 0, 63 },
+	{ "king_pcsq", king_pcsq, 64, 0, 63 },
+	{ "king_endgame_pcsq", king_endgame_pcsq, 64, 0, 63 }
+};
+
+#define PARAMS ((int)(sizeof(param) / sizeof(param[0])))
+
+
+/* pack() stores the current position in p */
+
+static void pack(tpos_t *p, int result)
+{
+	int i, x;
+
+	memset(p->sq, 0, sizeof(p->sq));
+	for (i = 0; i < 64; ++i) {
+		x = (COLOR(i) == EMPTY) ? 0 : 1 + COLOR(i) * 6 + PIECE(i);
+		p->sq[i >> 1] |= x << ((i & 1) * 4);
+	}
+	p->flags = (unsigned char)(castle | (side << 4));
+	p->ep = (signed char)ep;
+	p->result = (unsigned char)result;
+}
+
+
+/* unpack() sets up the position stored in p */
+
+static void unpack(tpos_t *p)
+{
+	int i, x;
+
+	for (i = 0; i < 64; ++i) {
+		x = (p->sq[i >> 1] >> ((i & 1) * 4)) & 15;
+		board[i] = x ? MAN((x - 1) / 6, (x - 1) % 6) : EMPTY_SQ;
+	}
+	castle = p->flags & 15;
+	side = p->flags >> 4;
+	xside = side ^ 1;
+	ep = p->ep;
+	fifty = 0;
+	ply = 0;
+	hply = 0;
+	first_move[0] = 0;
+	set_hash();
+	set_material();
+}
+
+
+/* parse_result() returns the result in an EPD line's operations, in
+   the form of tpos_t.result, or -1 if there isn't one */
+
+static int parse_result(char *s)
+{
+	if (strstr(s, "1/2") || strstr(s, "[0.5]"))
+		return 1;
+	if (strstr(s, "1-0") || strstr(s, "[1.0]"))
+		return 2;
+	if (strstr(s, "0-1") || strstr(s, "[0.0]"))
+		return 0;
+	return -1;
+}
+
+
+/* load_epd() reads the positions in file into tpos[] */
+
+static BOOL load_epd(char *file)
+{
+	FILE *f;
+	char line[512];
+	char *rest;
+	int r, size = 0, bad = 0;
+	long long t = get_ms();
+
+	f = fopen(file, "r");
+	if (!f) {
+		printf("Can't open %s.\n", file);
+		return FALSE;
+	}
+	tpos_count = 0;
+	while (fgets(line, sizeof(line), f)) {
+		rest = set_fen(line);
+		r = rest ? parse_result(rest) : -1;
+		if (r == -1) {
+			++bad;
+			continue;
+		}
+		if (tpos_count == size) {
+			size = size ? size * 2 : 65536;
+			tpos = (tpos_t *)realloc(tpos, size * sizeof(tpos_t));
+			if (!tpos) {
+				printf("Out of memory.\n");
+				fclose(f);
+				tpos_count = 0;
+				return FALSE;
+			}
+		}
+		pack(&tpos[tpos_count++], r);
+	}
+	fclose(f);
+	printf("Loaded %d positions (%.1f MB) in %lld ms", tpos_count,
+			(double)tpos_count * sizeof(tpos_t) / 1048576.0, get_ms() - t);
+	if (bad)
+		printf(", skipped %d lines without a position and result", bad);
+	printf(".\n");
+	fflush(stdout);
+	return tpos_count > 0;
+}
+
+
+static double sigmoid(double k, int score)
+{
+	return 1.0 / (1.0 + pow(10.0, -k * score / 400.0));
+}
+
+
+/* error_slice() is the work of thread i in total_error(). The pawn hash
+   and eval cache are emptied first, since the terms have changed since
+   the last call. */
+
+static void error_slice(int i, void *arg)
+{
+	slice_t *s = (slice_t *)arg + i;
+	int n, x;
+	double d;
+
+	initPHT();
+	initEC();
+	stop_ns = (long long)1 << 62;  /* checkup() must never time out */
+	s->error = 0.0;
+	for (n = s->first; n < s->last; ++n) {
+		unpack(&tpos[n]);
+		follow_pv = FALSE;
+		x = quiesce(-10000, 10000);
+		if (side == DARK)
+			x = -x;
+		if (s->score)
+			s->score[n] = x;
+		d = tpos[n].result / 2.0 - sigmoid(tune_k, x);
+		s->error += d * d;
+	}
+}
+
+
+/* total_error() returns the mean squared error over all the positions.
+   If score isn't NULL, it also gets each position's score. */
+
+static double total_error(int *score)
+{
+	slice_t s[MAX_THREADS];
+	double e = 0.0;
+	int i;
+
+	for (i = 0; i < threads; ++i) {
+		s[i].first = (int)((long long)tpos_count * i / threads);
+		s[i].last = (int)((long long)tpos_count * (i + 1) / threads);
+		s[i].score = score;
+	}
+	run_threads(threads, error_slice, s);
+	for (i = 0; i < threads; ++i)
+		e += s[i].error;
+	tune_positions += tpos_count;
+	return e / tpos_count;
+}
+
+
+/* fit_k() finds the K that minimizes the error for the current terms.
+   The scores don't depend on K, so they're computed once. */
+
+static void fit_k()
+{
+	int *score;
+	int i, n;
+	double step, k, best_k, e, best;
+
+	score = (int *)malloc(tpos_count * sizeof(int));
+	if (!score) {
+		tune_k = 1.0;
+		return;
+	}
+	total_error(score);
+	best_k = 1.0;
+	best = 1e9;
+	/* scan 10 steps either way of the best K so far, again from the
+	   end if that's where the best was, then with a smaller step */
+	for (step = 0.1; step > 0.0005; step /= 10.0)
+		do {
+			k = best_k;
+			for (i = -10; i <= 10; ++i) {
+				if (k + i * step <= 0.0)
+					continue;
+				e = 0.0;
+				for (n = 0; n < tpos_count; ++n) {
+					double d = tpos[n].result / 2.0 - sigmoid(k + i * step, score[n]);
+					e += d * d;
+				}
+				e /= tpos_count;
+				if (e < best) {
+					best = e;
+					best_k = k + i * step;
+				}
+			}
+		} while (best_k > k + 9.5 * step);
+	free(score);
+	tune_k = best_k;
+	printf("K = %.3f\n", tune_k);
+	fflush(stdout);
+}
+
+
+/* write_params() writes the terms to file as C declarations, laid out
+   like eval.c's */
+
+static void write_params(char *file)
+{
+	FILE *f;
+	int i, j;
+	param_t *p;
+
+	f = fopen(file, "w");
+	if (!f) {
+		printf("Can't write %s.\n", file);
+		return;
+	}
+	for (i = 0; i < PARAMS; ++i) {
+		p = &param[i];
+		if (p->count == 1) {
+			fprintf(f, "int %s = %d;\n", p->name, *p->value);
+			continue;
+		}
+		if (i && param[i - 1].count == 1)
+			fprintf(f, "\n");
+		fprintf(f, "int %s[%d] = {\n", p->name, p->count);
+		if (p->count == 64)
+			for (j = 0; j < 64; ++j)
+				fprintf(f, "%s%3d%s", (j & 7) ? " " : "\t", p->value[j],
+						(j == 63) ? "\n" : ((j & 7) == 7 ? ",\n" : ","));
+		else
+			for (j = 0; j < p->count; ++j)
+				fprintf(f, "%s%d%s", j ? " " : "\t", p->value[j],
+						(j == p->count - 1) ? "\n" : ",");
+		fprintf(f, "};\n\n");
+	}
+	fclose(f);
+}
+
+
+/* tune() is the "tune" command */
+
+void tune(char *file)
+{
+	int i, j, pass, changed, *v;
+	BOOL nnue = use_nnue;
+	double e, best;
+	long long t, positions;
+
+	close_book();  /* set_fen() confuses the opening book code */
+	threads = cpu_count();
+	if (load_epd(file)) {
+		use_nnue = FALSE;
+		tuning = TRUE;
+		fit_k();
+		t = get_ms();
+		best = total_error(NULL);
+		t = get_ms() - t;
+		printf("Error: %.6f (%d threads, %.0f positions/sec)\n", best, threads,
+				tpos_count * 1000.0 / (t ? t : 1));
+		fflush(stdout);
+		for (pass = 1; ; ++pass) {
+			changed = 0;
+			positions = tune_positions;
+			t = get_ms();
+			for (i = 0; i < PARAMS; ++i)
+				for (j = param[i].first; j <= param[i].last; ++j) {
+					v = &param[i].value[j];
+					++*v;
+					init_pcsq();
+					e = total_error(NULL);
+					if (e < best) {
+						best = e;
+						++changed;
+						continue;
+					}
+					*v -= 2;
+					init_pcsq();
+					e = total_error(NULL);
+					if (e < best) {
+						best = e;
+						++changed;
+						continue;
+					}
+					++*v;
+					init_pcsq();
+				}
+			t = get_ms() - t;
+			write_params(TUNE_FILE);
+			printf("Pass %d: error %.6f, %d terms changed, %.0f positions/sec\n", pass,
+					best, changed, (tune_positions - positions) * 1000.0 / (t ? t : 1));
+			fflush(stdout);
+			if (!changed)
+				break;
+		}
+		printf("The terms are in %s, and in use until the program exits.\n", TUNE_FILE);
+		tuning = FALSE;
+		use_nnue = nnue;
+	}
+	free(tpos);
+	tpos = NULL;
+	tpos_count = 0;
+	initPHT();
+	initEC();
+	initHT();
+	init_board();
+	open_book();
+}